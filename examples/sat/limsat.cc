@@ -108,7 +108,7 @@ static bool LoadCnf(std::istream& stream,
     } else if (sscanf(line.c_str(), "p cnf %d %d", &n_funs, &n_clauses) == 2) {  // propositional CNF
       funs->clear();
       names->clear();
-      CreateTerms([](int i) { return Fun::FromId(i); }, n_funs, funs);
+      CreateTerms([](int i) { return Fun::FromIdChecked(i); }, n_funs, funs);
       F = Name::FromId(1);
       T = Name::FromId(2);
       names->push_back(T);
@@ -118,8 +118,8 @@ static bool LoadCnf(std::istream& stream,
     } else if (sscanf(line.c_str(), "p fcnf %d %d %d", &n_funs, &n_names, &n_clauses) == 3) {  // func CNF
       funs->clear();
       names->clear();
-      CreateTerms([](int i) { return Fun::FromId(i); }, n_funs, funs);
-      CreateTerms([](int i) { return Name::FromId(i); }, n_names + 1, names);
+      CreateTerms([](int i) { return Fun::FromIdChecked(i); }, n_funs, funs);
+      CreateTerms([](int i) { return Name::FromIdChecked(i); }, n_names + 1, names);
       *extra_name = names->back();
       prop = false;
     } else if (prop) {  // propositional clause
@@ -0,0 +1,144 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+//
+// Microbenchmark for the encoding of literals. It measures encoding and
+// decoding with BitInterleaver and BitConcatenator, and the Lit operations
+// for the encoding chosen at compile time (see LIMBO_LIT_CONCAT and
+// LIMBO_COMPACT_LIT), including the AVX2 subsumption kernel if enabled. Run
+// it on the target machine to pick the faster encoding, e.g.:
+//   ./litbench && ./litbench-concat
+
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <limbo/lit.h>
+#include <limbo/internal/ints.h>
+
+using namespace limbo;
+using namespace limbo::internal;
+
+static constexpr int kN = 1 << 16;
+static constexpr int kRounds = 2000;
+
+static std::vector<u32> RandomIds(u32 seed, u32 max) {
+  std::vector<u32> ids(kN);
+  for (u32& id : ids) {
+    seed = seed * 1103515245 + 12345;
+    id = 1 + (seed >> 8) % max;
+  }
+  return ids;
+}
+
+template<typename Function>
+static void Measure(const char* label, Function f) {
+  const std::clock_t start = std::clock();
+  u64 sink = 0;
+  for (int r = 0; r < kRounds; ++r) {
+    sink += f(r);
+  }
+  const double secs = (std::clock() - start) / double(CLOCKS_PER_SEC);
+  std::printf("%-28s %8.2f ns/op  (%llu)\n", label, 1e9 * secs / (double(kRounds) * kN),
+              static_cast<unsigned long long>(sink));
+}
+
+template<typename Bits>
+static void MeasureBits(const char* name, const std::vector<u32>& his, const std::vector<u32>& los) {
+  char label[64];
+  std::vector<u64> zs(kN);
+  std::snprintf(label, sizeof(label), "%s::merge", name);
+  Measure(label, [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      zs[i] = Bits::merge(his[i], los[i] ^ r);
+      sink += zs[i];
+    }
+    return sink;
+  });
+  std::snprintf(label, sizeof(label), "%s::split", name);
+  Measure(label, [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      sink += Bits::split_hi(zs[i] ^ r) + Bits::split_lo(zs[i]);
+    }
+    return sink;
+  });
+}
+
+int main() {
+  const std::vector<u32> funs = RandomIds(1, 1 << 12);
+  const std::vector<u32> names = RandomIds(2, 1 << 8);
+
+  MeasureBits<BitInterleaver<u32>>("BitInterleaver", funs, names);
+  MeasureBits<BitConcatenator<u32>>("BitConcatenator", funs, names);
+
+#ifdef LIMBO_LIT_CONCAT
+  std::printf("Lit encoding: BitConcatenator\n");
+#else
+  std::printf("Lit encoding: BitInterleaver\n");
+#endif
+  // Few functions and names, so that many pairs share the function.
+  const std::vector<u32> few_funs = RandomIds(3, 8);
+  const std::vector<u32> few_names = RandomIds(4, 4);
+  std::vector<Lit> lits(kN);
+  Measure("Lit::Lit", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      lits[i] = Lit(((i ^ r) & 1) != 0, Fun::FromId(few_funs[i]), Name::FromId(few_names[i]));
+      sink += lits[i].id();
+    }
+    return sink;
+  });
+  Measure("Lit::fun/name", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      const Lit a = lits[(i + r) & (kN - 1)];
+      sink += a.fun().id() + a.name().id();
+    }
+    return sink;
+  });
+  Measure("Lit::Valid", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      sink += Lit::Valid(lits[i], lits[(i + r) & (kN - 1)]);
+    }
+    return sink;
+  });
+  Measure("Lit::Complementary", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      sink += Lit::Complementary(lits[i], lits[(i + r) & (kN - 1)]);
+    }
+    return sink;
+  });
+  Measure("Lit::Subsumes", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i < kN; ++i) {
+      sink += Lit::Subsumes(lits[i], lits[(i + r) & (kN - 1)]);
+    }
+    return sink;
+  });
+  Measure("Lit::Subsumes x 8", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i + 8 <= kN; i += 8) {
+      const Lit a = lits[(i + r) & (kN - 1)];
+      for (int j = i; j < i + 8; ++j) {
+        if (Lit::Subsumes(a, lits[j])) {
+          ++sink;
+          break;
+        }
+      }
+    }
+    return sink;
+  });
+  Measure("Lit::SubsumesAny x 8", [&](int r) {
+    u64 sink = 0;
+    for (int i = 0; i + 8 <= kN; i += 8) {
+      const Lit a = lits[(i + r) & (kN - 1)];
+      sink += Lit::SubsumesAny(a, &lits[i], &lits[i + 8]);
+    }
+    return sink;
+  });
+  return 0;
+}
+
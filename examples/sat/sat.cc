@@ -112,7 +112,7 @@ static bool LoadCnf(std::istream& stream,
       header = true;
       funs->clear();
       names->clear();
-      CreateTerms([](int i) { return Fun::FromId(i); }, n_funs, funs);
+      CreateTerms([](int i) { return Fun::FromIdChecked(i); }, n_funs, funs);
       F = Name::FromId(1);
       T = Name::FromId(2);
       names->push_back(T);
@@ -123,8 +123,8 @@ static bool LoadCnf(std::istream& stream,
       header = true;
       funs->clear();
       names->clear();
-      CreateTerms([](int i) { return Fun::FromId(i); }, n_funs, funs);
-      CreateTerms([](int i) { return Name::FromId(i); }, n_names + 1, names);
+      CreateTerms([](int i) { return Fun::FromIdChecked(i); }, n_funs, funs);
+      CreateTerms([](int i) { return Name::FromIdChecked(i); }, n_names + 1, names);
       *extra_name = names->back();
       prop = false;
     } else if (prop) {  // propositional clause
@@ -169,7 +169,8 @@ static bool LoadCnf(std::istream& stream,
   return prop;
 }
 
-bool Solve(Sat<>* sat, int max_conflicts_init, int conflicts_increase) {
+template<typename SatT>
+bool Solve(SatT* sat, int max_conflicts_init, int conflicts_increase) {
   struct Stats {
     int n_conflicts             = 0;
     int n_decisions             = 0;
@@ -179,10 +180,10 @@ bool Solve(Sat<>* sat, int max_conflicts_init, int conflicts_increase) {
   } stats;
   bool restarts = max_conflicts_init >= 0;
   int max_conflicts = max_conflicts_init;
-  Sat<>::Truth truth = Sat<>::Truth::kUnknown;
+  typename SatT::Truth truth = SatT::Truth::kUnknown;
 
   auto update_avg = [](double* avg, auto n, auto x) { *avg = double(n) / double(n + 1) * *avg + double(x) / double(n + 1); };
-  auto conflict_predicate = [&](int level, Sat<>::CRef, const std::vector<Lit>&, int btlevel) {
+  auto conflict_predicate = [&](int level, typename SatT::CRef, const std::vector<Lit>&, int btlevel) {
     update_avg(&stats.avg_conflict_level,   stats.n_conflicts, level);
     update_avg(&stats.avg_conflict_btlevel, stats.n_conflicts, btlevel);
     ++stats.n_conflicts;
@@ -196,12 +197,12 @@ bool Solve(Sat<>* sat, int max_conflicts_init, int conflicts_increase) {
 
   Timer t;
   t.start();
-  for (int i = 0; truth == Sat<>::Truth::kUnknown; ++i) {
+  for (int i = 0; truth == SatT::Truth::kUnknown; ++i) {
     max_conflicts = static_cast<int>(std::pow(conflicts_increase, i) * max_conflicts_init);
     truth = sat->Solve(conflict_predicate, decision_predicate);
   }
   t.stop();
-  printf("%s (in %.5lfs)\n", (truth == Sat<>::Truth::kSat ? "SATISFIABLE" : "UNSATISFIABLE"), t.duration());
+  printf("%s (in %.5lfs)\n", (truth == SatT::Truth::kSat ? "SATISFIABLE" : "UNSATISFIABLE"), t.duration());
   printf("Clauses: %d | Propagate from learnt: %s\n",
          int(sat->clauses().size()) - 1,
          sat->propagate_with_learnt() ? "yes" : "no");
@@ -211,10 +212,11 @@ bool Solve(Sat<>* sat, int max_conflicts_init, int conflicts_increase) {
          stats.avg_conflict_btlevel,
          stats.n_decisions,
          stats.avg_decision_level);
-  return truth == Sat<>::Truth::kSat;
+  return truth == SatT::Truth::kSat;
 }
 
-void PrintSolution(const Sat<>& sat, const bool prop, const int n_columns, bool show_funs,
+template<typename SatT>
+void PrintSolution(const SatT& sat, const bool prop, const int n_columns, bool show_funs,
                    const std::vector<Fun>& funs, const std::vector<Name>& names,
                    const bool extra, const Name extra_name) {
   struct winsize ws;
@@ -268,6 +270,7 @@ int main(int argc, char *argv[]) {
   int n_conflicts_before_restart = -1;
   int loaded = 0;
   int extra = true;
+  int vmtf = false;
   bool prop = false;
   for (int i = 1; i < argc; ++i) {
     if (argv[i] == std::string("-h") || argv[i] == std::string("--help")) {
@@ -283,6 +286,7 @@ int main(int argc, char *argv[]) {
       std::cout << "--iterations=int -i=int  repretitions with clauses learnt so far (default: " << n_iterations << ")" << std::endl;
       std::cout << "--models=int     -n=int  how many models to find (default: " << n_models << ", infinity: -1)" << std::endl;
       std::cout << "--restart=int    -r=int  conflicts before restart, (default: " << n_conflicts_before_restart << ", infinity: -1)" << std::endl;
+      std::cout << "--vmtf=bool      -v=bool move-to-front instead of activity heap (default: " << vmtf << ")" << std::endl;
       std::cout << std::endl;
 #ifndef NDEBUG
       std::cout << "Debugging is turned on (NDEBUG is not defined)." << std::endl;
@@ -296,6 +300,7 @@ int main(int argc, char *argv[]) {
     } else if (sscanf(argv[i], "--iterations=%d", &n_iterations) == 1 || sscanf(argv[i], "-i=%d", &n_iterations) == 1) {
     } else if (sscanf(argv[i], "--models=%d", &n_models) == 1 || sscanf(argv[i], "-n=%d", &n_models) == 1) {
     } else if (sscanf(argv[i], "--restart=%d", &n_conflicts_before_restart) == 1 || sscanf(argv[i], "-r=%d", &n_conflicts_before_restart) == 1) {
+    } else if (sscanf(argv[i], "--vmtf=%d", &vmtf) == 1 || sscanf(argv[i], "-v=%d", &vmtf) == 1) {
     } else if (loaded == 0 && argv[i][0] != '-') {
       std::ifstream ifs = std::ifstream(argv[i]);
       prop = LoadCnf(ifs, &cnf, &funs, &names, &extra_name);
@@ -314,44 +319,52 @@ int main(int argc, char *argv[]) {
 
   Timer timer_total;
   timer_total.start();
-  Sat<> sat;
-  for (const std::vector<Lit>& lits : cnf) {
-    for (const Lit a : lits) {
-      if (!sat.registered(a.fun(), a.name())) {
-        sat.Register(a.fun(), a.name());
+  auto run = [&](auto& sat) {
+    for (const std::vector<Lit>& lits : cnf) {
+      for (const Lit a : lits) {
+        if (!sat.registered(a.fun(), a.name())) {
+          sat.Register(a.fun(), a.name());
+        }
       }
     }
-  }
-  sat.RegisterExtraName(extra_name);
-  for (const std::vector<Lit>& lits : cnf) {
-    sat.AddClause(lits);
-  }
-  for (int i_iterations = 1; i_iterations <= n_iterations; ++i_iterations) {
-    sat.Simplify();
-    int i_models;
-    for (i_models = 0; i_models < n_models || n_models < 0; ++i_models) {
-      sat.set_propagate_with_learnt(true);
-      //sat.set_propagate_with_learnt(false);
-      const bool satisfied = Solve(&sat, n_conflicts_before_restart, 2);
-      if (!satisfied) {
-        break;
-      }
-      if (n_columns >= 0) {
-        PrintSolution(sat, prop, n_columns, show_funs, funs, names, extra, extra_name);
-      }
-      std::vector<Lit> lits;
-      for (const Fun f : funs) {
-        const Name n = sat.model()[f];
-        lits.push_back(Lit::Neq(f, n));
+    sat.RegisterExtraName(extra_name);
+    for (const std::vector<Lit>& lits : cnf) {
+      sat.AddClause(lits);
+    }
+    for (int i_iterations = 1; i_iterations <= n_iterations; ++i_iterations) {
+      sat.Simplify();
+      int i_models;
+      for (i_models = 0; i_models < n_models || n_models < 0; ++i_models) {
+        sat.set_propagate_with_learnt(true);
+        //sat.set_propagate_with_learnt(false);
+        const bool satisfied = Solve(&sat, n_conflicts_before_restart, 2);
+        if (!satisfied) {
+          break;
+        }
+        if (n_columns >= 0) {
+          PrintSolution(sat, prop, n_columns, show_funs, funs, names, extra, extra_name);
+        }
+        std::vector<Lit> lits;
+        for (const Fun f : funs) {
+          const Name n = sat.model()[f];
+          lits.push_back(Lit::Neq(f, n));
+        }
+        if (n_models != 1) {
+          sat.AddClause(lits);
+        }
       }
       if (n_models != 1) {
-        sat.AddClause(lits);
+        std::cout << "Found " << i_models << " models" << std::endl;
       }
+      sat.Reset();
     }
-    if (n_models != 1) {
-      std::cout << "Found " << i_models << " models" << std::endl;
-    }
-    sat.Reset();
+  };
+  if (vmtf) {
+    Sat<double, MoveToFrontQueue> sat;
+    run(sat);
+  } else {
+    Sat<> sat;
+    run(sat);
   }
   timer_total.stop();
   if (timer_total.rounds() > 1) {
@@ -8,6 +8,7 @@
 #include <sstream>
 #include <vector>
 
+#include <limbo/grounder.h>
 #include <limbo/limsat.h>
 #include <limbo/internal/maybe.h>
 #include <limbo/io/output.h>
@@ -135,7 +136,7 @@ class KnowledgeBase {
     }
 #else
     for (int i = 1; i <= 9; ++i) {
-      if (!lim_sat_.Solve(k, eq(cellf(p), valn(i)).readable())) {
+      if (!lim_sat_.Solve(k, Lit::Eq(cellf(p), valn(i)), &ladder(p, i))) {
         return limbo::internal::Just(i);
       }
     }
@@ -150,10 +151,10 @@ class KnowledgeBase {
   void PrintDimacs(std::ostream* os) {
     using namespace limbo;
     using namespace limbo::io;
-    const std::set<std::vector<Lit>>& cs = lim_sat_.clauses();
+    const internal::ArenaSet<Lit>& cs = lim_sat_.clauses();
     *os << "p fcnf 81 9 " << (cs.size() + 81) << std::endl;
     *os << "c Sudoku rules" << std::endl;
-    for (const std::vector<Lit>& c : cs) {
+    for (const internal::ArenaSet<Lit>::Range c : cs) {
       for (Lit a : c) {
         int i = 0;
         for (int x = 1; x <= 9; ++x) {
@@ -175,7 +176,7 @@ class KnowledgeBase {
         *os << (i < 10 ? " " : "") << (a.pos() ? ' ' : '-') << i << '=' << j << ' ';
       }
       *os << '0' << std::endl;
-      *os << "c Clause '" << c << "' has size " << c.size() << std::endl;
+      *os << "c Clause '" << sequence(c) << "' has size " << c.size() << std::endl;
 next: {}
     }
   }
@@ -191,22 +192,13 @@ next: {}
   void Add(Formula&& f) {
     //std::cout << "Input: " << f << std::endl;
     f.Normalize();
+    f.Simplify();
     //std::cout << "Normalized: " << f << std::endl;
-    f.Ground([this](const Abc::Sort) -> const auto& { return n_; });
-    //std::cout << "Grounded: " << f << std::endl;
-    f.Strip();
-    //std::cout << "Stripped: " << f << std::endl;
-    Maybe<std::vector<std::vector<Lit>>> cs = f.readable().CnfClauses();
-    if (!cs) {
+    const bool succ = limbo::Grounder::StreamClauses(f.readable(),
+                                                     [this](const Abc::Sort) -> const auto& { return n_; },
+                                                     [this](const std::vector<Lit>& c) { Add(std::vector<Lit>(c)); });
+    if (!succ) {
       std::cerr << "No clauses extracted from " << f << std::endl;
-    } else {
-      //std::cout << cs.val.size() << " clauses" << std::endl;
-      //for (std::vector<Lit>& c : cs.val) {
-      //  std::cout << "Clause of length " << c.size() << ": " << c << std::endl;
-      //}
-      for (std::vector<Lit>& c : cs.val) {
-        Add(std::move(c));
-      }
     }
     //std::cout << std::endl;
   }
@@ -223,6 +215,8 @@ next: {}
   Fun&  cellf(int x, int y)       { assert(1 <= x && x <= 9 && 1 <= y && y <= 9); return f_[(y-1) * 9 + x-1]; }
   Name& valn(int i)               { assert(1 <= i && i <= 10); return n_[i-1]; }
 
+  LimSat::Ladder& ladder(Point p, int i) { assert(1 <= i && i <= 9); return ladders_[((p.y-1) * 9 + p.x-1) * 9 + i-1]; }
+
   Abc::FunSymbol   cell(Point p)      const { return cell(p.x, p.y); }
   Abc::FunSymbol   cell(int x, int y) const { assert(1 <= x && x <= 9 && 1 <= y && y <= 9); return fs_[(y-1) * 9 + x-1]; }
   Abc::NameSymbol  val(int i)         const { assert(1 <= i && i <= 10); return ns_[i-1]; }
@@ -239,6 +233,7 @@ next: {}
 
   int    max_k_ = 0;
   LimSat lim_sat_{};
+  std::vector<LimSat::Ladder> ladders_ = std::vector<LimSat::Ladder>(9 * 9 * 9);
 
   Abc::Sort sort_ = abc().CreateSort(false);
 
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include <limbo/formula.h>
+#include <limbo/grounder.h>
 #include <limbo/limsat.h>
 #include <limbo/io/input.h>
 #include <limbo/io/output.h>
@@ -64,8 +65,18 @@ class EventHandler {
   bool Add(const Formula& f) {
     Formula ff = f.Clone();
     ff.Normalize();
+    ff.Simplify();
     ff.Strip();
-    if (!ff.readable().proper_plus()) {
+    if (ff.readable().ground() && ff.readable().objective() && !ff.readable().dynamic()) {
+      // Small formulas are distributed into CNF. Larger ones are named by
+      // auxiliary literals, which LimSat splits like any other, so such a
+      // formula may only be believed at a higher level than its CNF.
+      const Grounder::node_t v = grounder_.Ground(ff.readable(), [](const Alphabet::Sort) { return std::vector<Name>(); });
+      return grounder_.DefinitionalClauses(v, [this](const std::vector<Lit>& c) {
+        lim_sat_->AddClause(c);
+        std::cout << "Added " << c << std::endl;
+      });
+    } else if (!ff.readable().proper_plus()) {
       return false;
     } else {
       std::vector<Lit> c;
@@ -93,7 +104,8 @@ class EventHandler {
   Alphabet&  abc() const { return Alphabet::instance(); }
   IoContext& io()  const { return IoContext::instance(); }
 
-  LimSat* lim_sat_;
+  LimSat*  lim_sat_;
+  Grounder grounder_{};
 };
 
 template<typename ForwardIt>
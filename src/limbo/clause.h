@@ -10,6 +10,11 @@
 //
 // The only way a normalized, non-valid clause can mention the same function
 // twice is in the form of equalities for different names.
+//
+// Every clause caches a 64-bit signature of the functions it mentions, a Bloom
+// filter with a single hash function. As c can only subsume d if every
+// function of c occurs in d, the signatures quickly reject most non-subsumed
+// clauses.
 
 #ifndef LIMBO_CLAUSE_H_
 #define LIMBO_CLAUSE_H_
@@ -87,6 +92,12 @@ next: {}
   }
   bool operator!=(const Clause& c) const { return !(*this == c); }
 
+  static internal::u64 FunSignature(const Lit a) {
+    return a.null() ? 0 : internal::u64(1) << (a.fun().id() & 63);
+  }
+
+  internal::u64 fun_signature() const { return h_.funs; }
+
   bool empty() const { return h_.size == 0; }
   bool unit()  const { return h_.size == 1; }
   int size()   const { return h_.size; }
@@ -110,14 +121,13 @@ next: {}
   bool unsat() const { return empty(); }
 
   bool Subsumes(const Clause& c) const {
+    if ((h_.funs & ~c.h_.funs) != 0) {
+      return false;
+    }
     for (Lit a : *this) {
-      for (Lit b : c) {
-        if (a.Subsumes(b)) {
-          goto next;
-        }
+      if (!Lit::SubsumesAny(a, c.begin(), c.end())) {
+        return false;
       }
-      return false;
-next: {}
     }
     return true;
   }
@@ -134,6 +144,7 @@ next: {}
       }
     }
     h_.size = i1;
+    UpdateFunSignature();
     assert(Normalized());
     return i2 - i1;
   }
@@ -142,6 +153,7 @@ next: {}
   explicit Clause(const Lit a) {
     h_.size = 1;
     as_[0] = a;
+    UpdateFunSignature();
     assert(Normalized());
   }
 
@@ -155,9 +167,17 @@ next: {}
       size = Normalize(h_.size, as_, invalid);
       h_.size = size >= 0 ? size : 1;
     }
+    UpdateFunSignature();
     assert(Normalized());
   }
 
+  void UpdateFunSignature() {
+    h_.funs = 0;
+    for (const Lit a : *this) {
+      h_.funs |= FunSignature(a);
+    }
+  }
+
 #ifndef NDEBUG
   bool Normalized() {
     for (int i = 0; i < h_.size; ++i) {
@@ -178,6 +198,7 @@ next: {}
 #endif
 
   struct {
+    internal::u64 funs;
     unsigned learnt :  1;
     unsigned size   : 31;
   } h_{};
@@ -2,8 +2,12 @@
 // Copyright 2014-2019 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// Formulas are represented as linked lists of symbols. For lightweight
-// copying and read-access, RFormulas only work with pointers to the list.
+// Formulas are represented as vectors of symbols in Polish notation. For
+// lightweight copying and read-access, RFormulas only work with iterators into
+// the vector. Rewriting passes build a new vector rather than splicing the old
+// one. Every formula also keeps a skip table that holds the size of the
+// subformula or term that starts at each symbol, so that RFormulas can jump
+// over arguments instead of scanning them.
 
 #ifndef LIMBO_FORMULA_H_
 #define LIMBO_FORMULA_H_
@@ -11,9 +15,11 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
-#include <list>
+#include <atomic>
+#include <deque>
+#include <iterator>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -101,7 +107,7 @@ class Alphabet : private internal::Singleton<Alphabet> {
       kNot, kOr, kAnd, kExists, kForall, kKnow, kMaybe, kBelieve, kAction
     };
 
-    using List = std::list<Symbol>;
+    using List = std::vector<Symbol>;
     using Ref  = List::iterator;
     using CRef = List::const_iterator;
 
@@ -189,7 +195,7 @@ class Alphabet : private internal::Singleton<Alphabet> {
         case kAnd:          return u.k;
         case kKnow:         return 1;
         case kMaybe:        return 1;
-        case kBelieve:      return 1;
+        case kBelieve:      return 2;
         case kAction:       return 2;
       }
       std::abort();
@@ -241,7 +247,7 @@ class Alphabet : private internal::Singleton<Alphabet> {
    private:
     template<typename T>
     struct EmptyList {
-      static const std::list<T> kInstance;
+      static const std::vector<T> kInstance;
     };
 
     Symbol::CRef begin_ = EmptyList<Symbol>::kInstance.begin();
@@ -252,7 +258,7 @@ class Alphabet : private internal::Singleton<Alphabet> {
    public:
     explicit Word() = default;
     explicit Word(const RWord& w) : Word(w.begin(), w.end()) {}
-    explicit Word(Symbol::List&& w) : symbols_(w) {}
+    explicit Word(Symbol::List&& w) : symbols_(std::move(w)) {}
 
     template<typename InputIt>
     explicit Word(const InputIt begin, const InputIt end) : symbols_(begin, end) {}
@@ -283,20 +289,6 @@ class Alphabet : private internal::Singleton<Alphabet> {
     Symbol::Ref Erase(const Symbol::Ref first, const Symbol::Ref last) { return symbols_.erase(first, last); }
     Symbol::Ref Erase(const Symbol::Ref it) { return symbols_.erase(it); }
 
-    void Move(const Symbol::Ref before, const Symbol::Ref first) { symbols_.splice(before, symbols_, first); }
-
-    Symbol::List TakeOut(const Symbol::Ref first, const Symbol::Ref last) {
-      Symbol::List tgt;
-      tgt.splice(tgt.end(), symbols_, first, last);
-      return tgt;
-    }
-
-    void PutIn(const Symbol::Ref before, Symbol::List&& symbols) {
-      symbols_.splice(before, symbols, symbols.begin(), symbols.end());
-    }
-
-    void PutIn(const Symbol::Ref before, Word&& w) { PutIn(before, std::move(w.symbols_)); }
-
    private:
     Word(const Word&)            = default;
     Word& operator=(const Word&) = default;
@@ -304,6 +296,18 @@ class Alphabet : private internal::Singleton<Alphabet> {
     Symbol::List symbols_{};
   };
 
+  // An ActionSeq stands for a sequence of action terms t_1,...,t_m. Sequences
+  // are persistent lists that are hash-consed by Extend(), so that equal
+  // sequences have the same id and share the squared functions cached for
+  // them. The null ActionSeq is the empty sequence.
+  class ActionSeq : public IntRepresented {
+   public:
+    using IntRepresented::IntRepresented;
+    ActionSeq prefix() const { return null() ? ActionSeq() : instance().action_node(*this).prefix; }
+    int length()       const { return null() ? 0 : instance().action_node(*this).length; }
+    RWord actions()    const { return null() ? RWord() : instance().action_node(*this).actions.readable(); }
+  };
+
   static Alphabet& instance() {
     if (instance_ == nullptr) {
       instance_ = std::unique_ptr<Alphabet>(new Alphabet());
@@ -367,27 +371,102 @@ class Alphabet : private internal::Singleton<Alphabet> {
     }
   }
 
+  // Returns the sequence t_1,...,t_m,t for z = t_1,...,t_m.
+  ActionSeq Extend(const ActionSeq z, const RWord& t) {
+    assert(!t.empty() && t.begin()->term());
+    const internal::hash64_t h = internal::murmur64a_hash(internal::u64(z.id()), TermHash(t));
+    const int i = FindActionSeq(h, z, t);
+    if (!action_slots_[i].null()) {
+      return action_slots_[i];
+    }
+    const ActionSeq zt = ActionSeq(action_nodes_.size() + 1);
+    const RWord u = z.actions();
+    Symbol::List symbols;
+    symbols.reserve((u.end() - u.begin()) + (t.end() - t.begin()));
+    symbols.insert(symbols.end(), u.begin(), u.end());
+    symbols.insert(symbols.end(), t.begin(), t.end());
+    action_nodes_.emplace_back(z, z.length() + 1, h, u.end() - u.begin(), Word(std::move(symbols)));
+    action_slots_[i] = zt;
+    if (2 * int(action_nodes_.size()) > int(action_slots_.size())) {
+      RehashActionSeqs();
+    }
+    return zt;
+  }
+
+  // Returns the word f^m t_1 ... t_m for z = t_1,...,t_m, that is, the
+  // squared function followed by its first m arguments. The word is built
+  // once per z and f; later calls return the same word.
+  RWord Squaring(const ActionSeq z, const FunSymbol f) {
+    const internal::hash64_t h = internal::murmur64a_hash((internal::u64(z.id()) << 32) | internal::u32(f.id()));
+    const int mask = squared_slots_.size() - 1;
+    int i = h & mask;
+    for (; squared_slots_[i].word != 0; i = (i + 1) & mask) {
+      if (squared_slots_[i].z == z && squared_slots_[i].f == f) {
+        return squared_words_[squared_slots_[i].word - 1].readable();
+      }
+    }
+    const RWord u = z.actions();
+    Symbol::List symbols;
+    symbols.reserve(1 + (u.end() - u.begin()));
+    symbols.push_back(Symbol::Fun(Squaring(z.length(), f)));
+    symbols.insert(symbols.end(), u.begin(), u.end());
+    squared_words_.emplace_back(std::move(symbols));
+    squared_slots_[i].z = z;
+    squared_slots_[i].f = f;
+    squared_slots_[i].word = squared_words_.size();
+    const RWord w = squared_words_.back().readable();
+    if (2 * int(squared_words_.size()) > int(squared_slots_.size())) {
+      RehashSquared();
+    }
+    return w;
+  }
+
+  // Strip() and Unstrip() may be called from several threads at once after
+  // set_concurrent(true); all other functions must not run concurrently with
+  // anything else. Otherwise no locks are taken.
+  void set_concurrent(const bool b) {
+    concurrent_ = b;
+    if (concurrent_) {
+      // Reads from DenseMaps may grow them up to the next power of two.
+      sort_rigid_.FitForIndex(internal::next_power_of_two(last_sort_));
+      fun_sort_.FitForIndex(internal::next_power_of_two(last_fun_));
+      fun_arity_.FitForIndex(internal::next_power_of_two(last_fun_));
+      name_sort_.FitForIndex(internal::next_power_of_two(last_name_));
+      name_arity_.FitForIndex(internal::next_power_of_two(last_name_));
+      var_sort_.FitForIndex(internal::next_power_of_two(last_var_));
+    }
+  }
+
+  bool concurrent() const { return concurrent_; }
+
   Symbol Strip(Word&& w) {
     assert(w.begin()->tag == Symbol::kFun || w.begin()->tag == Symbol::kName);
     assert(std::all_of(std::next(w.begin()), w.end(), [](const Symbol& s) { return s.tag == Symbol::kStrippedName; }));
-    auto it = symbols_term_.find(w.readable());
-    if (it != symbols_term_.end()) {
-      return it->second;
+    const internal::hash64_t h = TermHash(w.readable());
+    TermShard& shard = term_shards_[h >> (64 - kTermShardBits)];
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (concurrent_) {
+      lock.lock();
+    }
+    TermSlot& slot = shard.slots[FindTerm(shard, h, w.readable())];
+    if (slot.symbol.tag != 0) {
+      return slot.symbol;
+    }
+    if (w.begin()->tag == Symbol::kFun) {
+      const Fun f = Fun::FromIdChecked(++last_fun_term_);
+      term_funs_.Put(f.id(), std::move(w));
+      slot.symbol = Symbol::StrippedFun(f);
     } else {
-      if (w.begin()->tag == Symbol::kFun) {
-        const Fun f = Fun::FromId(++last_fun_term_);
-        const Symbol s = Symbol::StrippedFun(f);
-        term_fun_symbols_[f] = std::move(w);
-        symbols_term_[term_fun_symbols_[f].readable()] = s;
-        return s;
-      } else {
-        const Name n = Name::FromId(++last_name_term_);
-        const Symbol s = Symbol::StrippedName(n);
-        term_name_symbols_[n] = std::move(w);
-        symbols_term_[term_name_symbols_[n].readable()] = s;
-        return s;
-      }
+      const Name n = Name::FromIdChecked(++last_name_term_);
+      term_names_.Put(n.id(), std::move(w));
+      slot.symbol = Symbol::StrippedName(n);
+    }
+    slot.hash = h;
+    const Symbol s = slot.symbol;
+    if (2 * ++shard.size > int(shard.slots.size())) {
+      RehashTerms(&shard);
     }
+    return s;
   }
 
   RWord Unstrip(const Symbol& s) const {
@@ -395,38 +474,198 @@ class Alphabet : private internal::Singleton<Alphabet> {
     return s.tag == Symbol::kStrippedFun ? Unstrip(s.u.f_s) : Unstrip(s.u.n_s);
   }
 
-  RWord Unstrip(Fun f)  const { return term_fun_symbols_.key_in_range(f) ? term_fun_symbols_[f].readable() : RWord(); }
-  RWord Unstrip(Name n) const { return term_name_symbols_.key_in_range(n) ? term_name_symbols_[n].readable() : RWord(); }
+  RWord Unstrip(Fun f)  const { return term_funs_.Get(f.id()); }
+  RWord Unstrip(Name n) const { return term_names_.Get(n.id()); }
 
  private:
-  struct DeepHash {
-    internal::hash32_t operator()(const RWord& w) const {
-      internal::hash32_t h = 0;
-      for (const Symbol& s : w) {
-        assert(s.term());
-        int i = 0;
-        switch (s.tag) {
-          case Symbol::kFun:          i = s.u.f.id();   break;
-          case Symbol::kName:         i = s.u.n.id();   break;
-          case Symbol::kVar:          i = s.u.x.id();   break;
-          case Symbol::kStrippedFun:  i = s.u.f_s.id(); break;
-          case Symbol::kStrippedName: i = s.u.n_s.id(); break;
-          default:                                      break;
-        }
-        h ^= internal::jenkins_hash(s.tag);
-        h ^= internal::jenkins_hash(i);
+  // Hashes the symbols one after another, so that the hash depends on their
+  // order.
+  static internal::hash64_t TermHash(const RWord& w) {
+    internal::hash64_t h = 0;
+    for (const Symbol& s : w) {
+      assert(s.term());
+      internal::u32 i = 0;
+      switch (s.tag) {
+        case Symbol::kFun:          i = s.u.f.id();   break;
+        case Symbol::kName:         i = s.u.n.id();   break;
+        case Symbol::kVar:          i = s.u.x.id();   break;
+        case Symbol::kStrippedFun:  i = s.u.f_s.id(); break;
+        case Symbol::kStrippedName: i = s.u.n_s.id(); break;
+        default:                                      break;
       }
-      return h;
+      h = internal::murmur64a_hash((internal::u64(s.tag) << 32) | i, h);
     }
+    return h;
+  }
+
+  static constexpr int kTermShardBits    = 4;
+  static constexpr int kTermShards       = 1 << kTermShardBits;
+  static constexpr int kInitialTermSlots = 64;
+
+  // A slot is empty if its symbol's tag is 0.
+  struct TermSlot {
+    internal::hash64_t hash = 0;
+    Symbol             symbol{};
   };
 
-  struct DeepEquals {
-    bool operator()(const RWord& w1, const RWord& w2) const {
-      return std::equal(w1.begin(), w1.end(), w2.begin());
+  // An open-addressing table with linear probing that maps terms to their
+  // stripped symbols. The terms themselves are not stored in the table but
+  // obtained with Unstrip(). The table's size is a power of two, and it uses
+  // the low bits of the hash, whereas the high bits select the shard.
+  struct TermShard {
+    std::mutex            mutex{};
+    std::vector<TermSlot> slots = std::vector<TermSlot>(kInitialTermSlots);
+    int                   size  = 0;
+  };
+
+  // Returns the index of the slot that holds w or of the empty slot where it
+  // belongs.
+  int FindTerm(const TermShard& shard, const internal::hash64_t h, const RWord& w) const {
+    const int mask = shard.slots.size() - 1;
+    int i = h & mask;
+    for (; shard.slots[i].symbol.tag != 0; i = (i + 1) & mask) {
+      const TermSlot& slot = shard.slots[i];
+      if (slot.hash == h) {
+        const RWord v = Unstrip(slot.symbol);
+        if (std::equal(v.begin(), v.end(), w.begin(), w.end())) {
+          break;
+        }
+      }
     }
+    return i;
+  }
+
+  static void RehashTerms(TermShard* shard) {
+    std::vector<TermSlot> slots(2 * shard->slots.size());
+    const int mask = slots.size() - 1;
+    for (const TermSlot& slot : shard->slots) {
+      if (slot.symbol.tag != 0) {
+        int i = slot.hash & mask;
+        while (slots[i].symbol.tag != 0) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+      }
+    }
+    shard->slots = std::move(slots);
+  }
+
+  // Append-only storage of the words of stripped terms, indexed by id. The
+  // words live in chunks of doubling size, which are never moved, so that a
+  // word can be read while other threads add new ones.
+  class TermStore {
+   public:
+    TermStore() { for (auto& c : chunks_) { c = nullptr; } }
+    ~TermStore() { for (auto& c : chunks_) { delete[] c.load(); } }
+
+    TermStore(const TermStore&)            = delete;
+    TermStore& operator=(const TermStore&) = delete;
+    TermStore(TermStore&&)                 = delete;
+    TermStore& operator=(TermStore&&)      = delete;
+
+    RWord Put(const internal::u32 id, Word&& w) {
+      assert(id > 0);
+      const int c = chunk(id);
+      Word* words = chunks_[c].load(std::memory_order_acquire);
+      if (words == nullptr) {
+        Word* new_words = new Word[internal::u32(1) << c];
+        if (chunks_[c].compare_exchange_strong(words, new_words, std::memory_order_acq_rel)) {
+          words = new_words;
+        } else {
+          delete[] new_words;
+        }
+      }
+      Word& slot = words[id - (internal::u32(1) << c)];
+      slot = std::move(w);
+      return slot.readable();
+    }
+
+    RWord Get(const internal::u32 id) const {
+      if (id == 0) {
+        return RWord();
+      }
+      const int c = chunk(id);
+      const Word* words = chunks_[c].load(std::memory_order_acquire);
+      return words != nullptr ? words[id - (internal::u32(1) << c)].readable() : RWord();
+    }
+
+   private:
+    static constexpr int kChunks = 32;
+
+    static int chunk(const internal::u32 id) { return 31 - __builtin_clz(id); }
+
+    std::atomic<Word*> chunks_[kChunks];
   };
 
-  using TermMap = std::unordered_map<RWord, Symbol, DeepHash, DeepEquals>;
+  struct ActionNode {
+    explicit ActionNode(ActionSeq prefix, int length, internal::hash64_t hash, int last, Word&& actions)
+        : prefix(prefix), length(length), hash(hash), last(last), actions(std::move(actions)) {}
+    ActionSeq          prefix{};
+    int                length = 0;
+    internal::hash64_t hash   = 0;
+    int                last   = 0;  // offset of t_m in actions
+    Word               actions{};   // t_1 ... t_m
+  };
+
+  // A slot is empty if its word is 0; otherwise word - 1 indexes squared_words_.
+  struct SquaredSlot {
+    ActionSeq z{};
+    FunSymbol f{};
+    int       word = 0;
+  };
+
+  static constexpr int kInitialActionSlots = 64;
+
+  const ActionNode& action_node(const ActionSeq z) const { return action_nodes_[z.id() - 1]; }
+
+  // Returns the index of the slot that holds the sequence z,t or of the empty
+  // slot where it belongs.
+  int FindActionSeq(const internal::hash64_t h, const ActionSeq z, const RWord& t) const {
+    const int mask = action_slots_.size() - 1;
+    int i = h & mask;
+    for (; !action_slots_[i].null(); i = (i + 1) & mask) {
+      const ActionNode& node = action_node(action_slots_[i]);
+      if (node.hash == h && node.prefix == z) {
+        const auto first = node.actions.begin() + node.last;
+        if (std::equal(first, node.actions.end(), t.begin(), t.end())) {
+          break;
+        }
+      }
+    }
+    return i;
+  }
+
+  void RehashActionSeqs() {
+    std::vector<ActionSeq> slots(2 * action_slots_.size());
+    const int mask = slots.size() - 1;
+    for (const ActionSeq z : action_slots_) {
+      if (!z.null()) {
+        int i = action_node(z).hash & mask;
+        while (!slots[i].null()) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = z;
+      }
+    }
+    action_slots_ = std::move(slots);
+  }
+
+  void RehashSquared() {
+    std::vector<SquaredSlot> slots(2 * squared_slots_.size());
+    const int mask = slots.size() - 1;
+    for (const SquaredSlot& slot : squared_slots_) {
+      if (slot.word != 0) {
+        const internal::hash64_t h =
+            internal::murmur64a_hash((internal::u64(slot.z.id()) << 32) | internal::u32(slot.f.id()));
+        int i = h & mask;
+        while (slots[i].word != 0) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+      }
+    }
+    squared_slots_ = std::move(slots);
+  }
 
   explicit Alphabet() = default;
 
@@ -442,21 +681,33 @@ class Alphabet : private internal::Singleton<Alphabet> {
   DenseMap<NameSymbol, int>  name_arity_{};
   DenseMap<VarSymbol,  Sort> var_sort_{};
 
-  TermMap              symbols_term_{};
-  DenseMap<Fun,  Word> term_fun_symbols_{};
-  DenseMap<Name, Word> term_name_symbols_{};
+  // term_shards_ map terms to their stripped symbol, and term_funs_ and
+  //    term_names_ map stripped symbols back to their terms; both are safe
+  //    for concurrent use, and the shards are locked if concurrent_ is set.
+  TermShard            term_shards_[kTermShards];
+  TermStore            term_funs_{};
+  TermStore            term_names_{};
+  bool                 concurrent_     = false;
   int                  last_sort_      = 0;
   int                  last_var_       = 0;
   int                  last_fun_       = 0;
   int                  last_name_      = 0;
-  int                  last_fun_term_  = 0;
-  int                  last_name_term_ = 0;
+  std::atomic<int>     last_fun_term_{0};
+  std::atomic<int>     last_name_term_{0};
 
   std::vector<DenseMap<FunSymbol, FunSymbol>> swear_funcs_{};
+
+  // action_nodes_ and squared_words_ are deques so that the RWords handed out
+  //    remain valid when they grow; action_slots_ and squared_slots_ are
+  //    open-addressing tables of power-of-two size that index them.
+  std::deque<ActionNode>   action_nodes_{};
+  std::vector<ActionSeq>   action_slots_ = std::vector<ActionSeq>(kInitialActionSlots);
+  std::deque<Word>         squared_words_{};
+  std::vector<SquaredSlot> squared_slots_ = std::vector<SquaredSlot>(kInitialActionSlots);
 };
 
 template<typename T>
-const std::list<T> Alphabet::RWord::EmptyList<T>::kInstance;
+const std::vector<T> Alphabet::RWord::EmptyList<T>::kInstance;
 
 class FormulaCommons {
  public:
@@ -504,6 +755,25 @@ class FormulaCommons {
     return it;
   }
 
+  // Returns the skip table of [first, last), that is, the size of the
+  // subformula or term that starts at each position.
+  template<typename BidirIt>
+  static std::vector<int> SubtreeSizes(const BidirIt first, BidirIt last) {
+    std::vector<int> sizes(std::distance(first, last));
+    std::vector<int> stack;
+    for (int i = int(sizes.size()) - 1; i >= 0; --i) {
+      const int arity = (--last)->arity();
+      int size = 1;
+      for (int j = 0; j < arity && !stack.empty(); ++j) {
+        size += stack.back();
+        stack.pop_back();
+      }
+      sizes[i] = size;
+      stack.push_back(size);
+    }
+    return sizes;
+  }
+
  protected:
   FormulaCommons() = default;
 };
@@ -514,6 +784,8 @@ class RFormula : private FormulaCommons {
   explicit RFormula(const Abc::Symbol::CRef begin, const Abc::Symbol::CRef end) : rword_(begin, end) {}
   explicit RFormula(const Abc::RWord& w) : RFormula(w.begin(), w.end()) {}
   explicit RFormula(const Abc::Symbol::CRef begin) : RFormula(begin, End(begin)) {}
+  explicit RFormula(const Abc::Symbol::CRef begin, const int* sizes)
+      : rword_(begin, std::next(begin, *sizes)), sizes_(sizes) {}
 
   const Abc::RWord& rword() const { return rword_; }
   const Abc::Symbol head()  const { return !empty() ? *begin() : Abc::Symbol(); }
@@ -535,6 +807,9 @@ class RFormula : private FormulaCommons {
   Abc::Symbol::CRef begin() const { return rword_.begin(); }
   Abc::Symbol::CRef end()   const { return rword_.end(); }
 
+  // The skip table of the formula or nullptr; see FormulaCommons::SubtreeSizes().
+  const int* sizes() const { return sizes_; }
+
   Abc::DenseSet<Abc::VarSymbol> FreeVars() const {
     struct QuantifierMarker {
       QuantifierMarker(Abc::VarSymbol x, Scope scope) : x(x), scope(scope) {}
@@ -793,12 +1068,21 @@ class RFormula : private FormulaCommons {
 
   void InitArg(const int i) {
     args_.reserve(arity());
-    while (int(args_.size()) <= i) {
-      args_.push_back(RFormula(!args_.empty() ? args_.back().end() : std::next(begin())));
+    if (sizes_) {
+      while (int(args_.size()) <= i) {
+        args_.push_back(!args_.empty()
+                        ? RFormula(args_.back().end(), args_.back().sizes_ + *args_.back().sizes_)
+                        : RFormula(std::next(begin()), std::next(sizes_)));
+      }
+    } else {
+      while (int(args_.size()) <= i) {
+        args_.push_back(RFormula(!args_.empty() ? args_.back().end() : std::next(begin())));
+      }
     }
   }
 
   Abc::RWord rword_{};
+  const int* sizes_ = nullptr;
   mutable std::vector<RFormula> args_{};
   struct {
     unsigned init                 : 1;
@@ -854,8 +1138,11 @@ class Formula : private FormulaCommons {
   static Formula Action(Formula&& t, Formula&& f)                              { return Formula(Abc::Symbol::Action(), t, f); }
   static Formula Action(const Formula& t, const Formula& f)                    { return Formula(Abc::Symbol::Action(), t, f); }
 
-  explicit Formula(Abc::Word&& w) : word_(std::move(w)) {}
-  explicit Formula(const RFormula& f) : word_(f.rword()) {}
+  explicit Formula(Abc::Word&& w) : word_(std::move(w)), sizes_(SubtreeSizes(word_.begin(), word_.end())) {}
+  explicit Formula(const RFormula& f)
+      : word_(f.rword()),
+        sizes_(f.sizes() ? std::vector<int>(f.sizes(), f.sizes() + word_.size())
+                         : SubtreeSizes(word_.begin(), word_.end())) {}
 
   Formula()                          = default;
   Formula(const Formula&)            = delete;
@@ -868,7 +1155,7 @@ class Formula : private FormulaCommons {
 
   Formula Clone() const { return Formula(word_.Clone()); }
 
-  RFormula           readable() const { return RFormula(begin(), end()); }
+  RFormula           readable() const { return !empty() ? RFormula(begin(), sizes_.data()) : RFormula(); }
   const Abc::Word&   word()     const { return word_; }
   const Abc::Symbol& head()     const { return *begin(); }
   Abc::Symbol::Tag   tag()      const { return head().tag; }
@@ -879,13 +1166,205 @@ class Formula : private FormulaCommons {
   Abc::Symbol::CRef begin() const { return word_.begin(); }
   Abc::Symbol::CRef end()   const { return word_.end(); }
 
+  // Symbols may only be replaced with symbols of the same arity through these
+  // iterators, for otherwise the skip table is invalidated.
   Abc::Symbol::Ref begin() { return word_.begin(); }
   Abc::Symbol::Ref end()   { return word_.end(); }
 
+  // Does the same as Rectify(), Flatten(), and PushInwards() in a single
+  // traversal; the result only differs in the names of new variables.
+  // All state is kept on one stack of frames. A frame is opened by a symbol
+  // and restores the state from before that symbol when its scope ends; the
+  // frame of a dis- or conjunction then also emits its collected arguments.
+  // Literals and action operators are rectified and flattened into a small
+  // buffer, which is fed through the same loop as the remaining symbols.
   void Normalize() {
-    Rectify();
-    Flatten();
-    PushInwards();
+    assert(readable().weakly_well_formed());
+    struct State {
+      bool pos     = true;   // polarity for flattening
+      bool neg     = false;  // whether a negation is pushed inwards
+      int  andor   = -1;     // innermost dis-, conjunction, or epistemic frame
+      int  actions = 0;      // first frame whose action applies to literals
+    };
+    struct Frame {
+      enum Kind { kAndOr, kReset, kAction, kQuantifier, kNot };
+      explicit Frame(Kind kind, Scope scope, State state) : kind(kind), scope(scope), state(state) {}
+      Kind kind;
+      Scope scope;
+      State state;
+      Abc::Symbol s{};              // the dis- or conjunction
+      Abc::Symbol::List symbols{};  // quantifiers pulled out of s, or the action
+      Abc::VarSymbol x{};           // the rectified variable
+      Abc::VarSymbol y{};           // the variable's previous replacement
+    };
+    Abc::DenseMap<Abc::VarSymbol, Abc::VarSymbol> renamed;
+    Abc::DenseSet<Abc::VarSymbol> used;
+    std::vector<Frame> frames;
+    State state;
+    Scope::Observer scoper;
+    std::vector<Abc::Symbol::List> buffers(1);
+    buffers.back().reserve(word_.size());
+    auto open = [&frames, &state, &scoper](const Frame::Kind kind) {
+      frames.push_back(Frame(kind, scoper.scope(), state));
+      return int(frames.size()) - 1;
+    };
+    auto munch = [&](const Abc::Symbol s) {
+      scoper.Munch(s);
+      while (!frames.empty() && !scoper.active(frames.back().scope)) {
+        const Frame& f = frames.back();
+        if (f.kind == Frame::kAndOr) {
+          Abc::Symbol::List args = std::move(buffers.back());
+          buffers.pop_back();
+          Abc::Symbol::List& parent = buffers.back();
+          parent.insert(parent.end(), f.symbols.begin(), f.symbols.end());
+          parent.push_back(f.s);
+          parent.insert(parent.end(), args.begin(), args.end());
+        } else if (f.kind == Frame::kQuantifier) {
+          renamed[f.x] = f.y;
+        }
+        state = f.state;
+        frames.pop_back();
+      }
+    };
+    // Pushes the flattened symbols [first, last) inwards. The body of an
+    // action operator in [first, last) is flattened with polarity body_pos.
+    auto feed = [&](Abc::Symbol::CRef it, const Abc::Symbol::CRef last, const bool body_pos) {
+      while (it != last) {
+        Abc::Symbol s = *it;
+        const bool reset = state.andor < 0 || frames[state.andor].kind == Frame::kReset;
+        switch (s.tag) {
+          case Abc::Symbol::kVar:
+          case Abc::Symbol::kFun:
+          case Abc::Symbol::kName:
+          case Abc::Symbol::kStrippedFun:
+          case Abc::Symbol::kStrippedName:
+            buffers.back().push_back(s);
+            munch(*it++);
+            break;
+          case Abc::Symbol::kEquals:
+          case Abc::Symbol::kNotEquals:
+          case Abc::Symbol::kStrippedLit: {
+            Abc::Symbol::List& symbols = buffers.back();
+            if (reset) {
+              symbols.push_back(Abc::Symbol::Or(1));
+            }
+            for (int i = state.actions; i < int(frames.size()); ++i) {
+              if (frames[i].kind == Frame::kAction) {
+                symbols.insert(symbols.end(), frames[i].symbols.begin(), frames[i].symbols.end());
+              }
+            }
+            if (state.neg) {
+              switch (s.tag) {
+                case Abc::Symbol::kEquals:      s.tag = Abc::Symbol::kNotEquals; break;
+                case Abc::Symbol::kNotEquals:   s.tag = Abc::Symbol::kEquals; break;
+                case Abc::Symbol::kStrippedLit: s.u.a = s.u.a.flip(); break;
+                default:                        assert(false); std::abort();
+              }
+            }
+            symbols.push_back(s);
+            munch(*it++);
+            break;
+          }
+          case Abc::Symbol::kKnow:
+          case Abc::Symbol::kMaybe:
+          case Abc::Symbol::kBelieve:
+            buffers.back().push_back(s);
+            state.andor = open(Frame::kReset);
+            state.actions = int(frames.size());
+            state.neg = false;
+            state.pos = true;
+            munch(*it++);
+            break;
+          case Abc::Symbol::kAction: {
+            const Abc::Symbol::CRef term_last = End(std::next(it));
+            open(Frame::kAction);
+            frames.back().symbols.assign(it, term_last);
+            state.pos = body_pos;
+            while (it != term_last) {
+              munch(*it++);
+            }
+            break;
+          }
+          case Abc::Symbol::kNot:
+            open(Frame::kNot);
+            state.neg = !state.neg;
+            state.pos = !state.pos;
+            munch(*it++);
+            break;
+          case Abc::Symbol::kExists:
+          case Abc::Symbol::kForall:
+            if (state.neg) {
+              s.tag = s.tag == Abc::Symbol::kExists ? Abc::Symbol::kForall : Abc::Symbol::kExists;
+            }
+            (!reset ? frames[state.andor].symbols : buffers.back()).push_back(s);
+            munch(*it++);
+            break;
+          case Abc::Symbol::kOr:
+          case Abc::Symbol::kAnd:
+            if (state.neg) {
+              s.tag = s.tag == Abc::Symbol::kOr ? Abc::Symbol::kAnd : Abc::Symbol::kOr;
+            }
+            if (!reset && (frames[state.andor].s.tag == s.tag || s.u.k == 1)) {
+              frames[state.andor].s.u.k += s.u.k - 1;
+            } else {
+              state.andor = open(Frame::kAndOr);
+              frames.back().s = s;
+              buffers.emplace_back();
+            }
+            munch(*it++);
+            break;
+        }
+      }
+    };
+    const Abc::RWord w = word_.readable();
+    Abc::Symbol::List atom;
+    Abc::Symbol::List flat;
+    for (Abc::Symbol::CRef it = w.begin(); it != w.end(); ) {
+      const int i = it - w.begin();
+      switch (it->tag) {
+        case Abc::Symbol::kEquals:
+        case Abc::Symbol::kNotEquals:
+        case Abc::Symbol::kAction: {
+          const Abc::Symbol::CRef last = it->tag != Abc::Symbol::kAction ? it + sizes_[i] : it + 1 + sizes_[i + 1];
+          atom.assign(it, last);
+          for (Abc::Symbol& s : atom) {
+            if (s.tag == Abc::Symbol::kVar && !renamed[s.u.x].null()) {
+              s.u.x = renamed[s.u.x];
+            }
+          }
+          flat.clear();
+          const bool body_pos = AppendFlattenedAtom(state.pos, atom.cbegin(), atom.cend(), &flat);
+          feed(flat.cbegin(), flat.cend(), body_pos);
+          it = last;
+          break;
+        }
+        case Abc::Symbol::kExists:
+        case Abc::Symbol::kForall: {
+          const Abc::VarSymbol x = it->u.x;
+          const Abc::VarSymbol y = !used[x] ? x : Abc::instance().CreateVar(x.sort());
+          used[x] = true;
+          open(Frame::kQuantifier);
+          frames.back().x = x;
+          frames.back().y = renamed[x];
+          renamed[x] = y;
+          state.pos = true;
+          flat.assign(1, *it);
+          flat.back().u.x = y;
+          feed(flat.cbegin(), flat.cend(), state.pos);
+          ++it;
+          break;
+        }
+        default:
+          feed(it, std::next(it), state.pos);
+          ++it;
+          break;
+      }
+    }
+    assert(frames.empty());
+    assert(buffers.size() == 1);
+    Reset(std::move(buffers.back()));
+    assert(readable().nnf());
+    assert(readable().weakly_well_formed());
   }
 
   // Eliminates existential (or, within an odd number of negations, universal)
@@ -915,6 +1394,8 @@ class Formula : private FormulaCommons {
     std::vector<ForallMarker> foralls;
     std::vector<NotMarker> nots;
     Scope::Observer scoper;
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
     for (auto it = begin(); it != end(); ) {
       const Abc::Symbol s = *it;
       const bool pos = nots.empty() || !nots.back().neg;
@@ -930,37 +1411,39 @@ class Formula : private FormulaCommons {
         case Abc::Symbol::kOr:
         case Abc::Symbol::kAnd:
         case Abc::Symbol::kAction:
+          symbols.push_back(s);
           scoper.Munch(*it++);
           break;
         case Abc::Symbol::kExists:
         case Abc::Symbol::kForall:
           if ((s.tag == Abc::Symbol::kExists) == pos) {
-            Abc::Symbol::List symbols;
+            const Abc::FunSymbol f = Abc::instance().CreateFun(s.u.x.sort(), foralls.size());
+            symbols.push_back(pos ? Abc::Symbol::Forall(s.u.x) : Abc::Symbol::Exists(s.u.x));
+            symbols.push_back(pos ? Abc::Symbol::Or(2) : Abc::Symbol::And(2));
+            symbols.push_back(pos ? Abc::Symbol::NotEquals() : Abc::Symbol::Equals());
+            symbols.push_back(Abc::Symbol::Fun(f));
             for (const ForallMarker& fm : foralls) {
               symbols.push_back(Abc::Symbol::Var(fm.x));
             }
-            const Abc::FunSymbol f = Abc::instance().CreateFun(s.u.x.sort(), symbols.size());
-            symbols.push_front(Abc::Symbol::Fun(f));
             symbols.push_back(Abc::Symbol::Var(s.u.x));
-            symbols.push_front(pos ? Abc::Symbol::NotEquals() : Abc::Symbol::Equals());
-            symbols.push_front(pos ? Abc::Symbol::Or(2) : Abc::Symbol::And(2));
-            it->tag = pos ? Abc::Symbol::kForall : Abc::Symbol::kExists;
-            word_.PutIn(std::next(it), std::move(symbols));
             scoper.Munch(*it++);
           } else {
+            symbols.push_back(s);
             scoper.Munch(*it++);
             foralls.push_back(ForallMarker(s.u.x, scoper.scope()));
           }
           break;
         case Abc::Symbol::kNot:
+          symbols.push_back(s);
           scoper.Munch(*it++);
           nots.push_back(NotMarker(nots.empty() || !nots.back().neg, scoper.scope()));
           break;
         case Abc::Symbol::kKnow:
         case Abc::Symbol::kMaybe:
         case Abc::Symbol::kBelieve:
-          scoper.Munch(*it++);
           nots.push_back(NotMarker(scoper.scope()));
+          symbols.push_back(s);
+          scoper.Munch(*it++);
           break;
       }
       while (!foralls.empty() && !scoper.active(foralls.back().scope)) {
@@ -970,32 +1453,36 @@ class Formula : private FormulaCommons {
         nots.pop_back();
       }
     }
+    Reset(std::move(symbols));
     assert(readable().weakly_well_formed());
   }
 
   // Replaces every function f(t_{m+1},...,t_n) in the scope of actions
-  // t_1,...,t_m with a new function f^m(t_1,...,t_n).
+  // t_1,...,t_m with a new function f^m(t_1,...,t_n). The action sequences
+  // and the words f^m t_1 ... t_m are shared through the Alphabet, so that
+  // repeated queries about the same actions need not rebuild them.
   // Precondition: Formula is objective.
   // Reason: We can't push actions inside epistemic operators.
   void Squaring() {
     assert(readable().weakly_well_formed());
     struct ActionMarker {
-      explicit ActionMarker(Abc::Symbol::List symbols, Scope scope) : symbols(symbols), scope(scope) {}
-      Abc::Symbol::List symbols{};
+      explicit ActionMarker(Abc::ActionSeq z, Scope scope) : z(z), scope(scope) {}
+      Abc::ActionSeq z{};
       Scope scope{};
     };
     std::vector<ActionMarker> actions;
     Scope::Observer scoper;
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
     for (auto it = begin(); it != end(); ) {
       switch (it->tag) {
-        case Abc::Symbol::kFun:
-          scoper.Munch(*it);
-          it->u.f = Abc::instance().Squaring(actions.size(), it->u.f);
-          ++it;
-          for (const ActionMarker& am : actions) {
-            word_.Insert(it, am.symbols.begin(), am.symbols.end());
-          }
+        case Abc::Symbol::kFun: {
+          const Abc::RWord w = actions.empty() ? Abc::RWord(it, std::next(it))
+                                               : Abc::instance().Squaring(actions.back().z, it->u.f);
+          symbols.insert(symbols.end(), w.begin(), w.end());
+          scoper.Munch(*it++);
           break;
+        }
         case Abc::Symbol::kVar:
         case Abc::Symbol::kName:
         case Abc::Symbol::kEquals:
@@ -1006,14 +1493,15 @@ class Formula : private FormulaCommons {
         case Abc::Symbol::kForall:
         case Abc::Symbol::kOr:
         case Abc::Symbol::kAnd:
+          symbols.push_back(*it);
           scoper.Munch(*it++);
           break;
         case Abc::Symbol::kAction: {
-          it = word_.Erase(it);
-          auto first = it;
-          auto last = End(it);
+          const auto first = std::next(it);
+          const auto last = End(first);
           it = last;
-          actions.push_back(ActionMarker(word_.TakeOut(first, last), scoper.scope()));
+          const Abc::ActionSeq z = actions.empty() ? Abc::ActionSeq() : actions.back().z;
+          actions.push_back(ActionMarker(Abc::instance().Extend(z, Abc::RWord(first, last)), scoper.scope()));
           break;
         }
         case Abc::Symbol::kStrippedFun:
@@ -1029,10 +1517,60 @@ class Formula : private FormulaCommons {
         actions.pop_back();
       }
     }
+    Reset(std::move(symbols));
     assert(readable().weakly_well_formed());
     assert(!readable().dynamic());
   }
 
+  // Progresses the formula through the ground action t, that is, rewrites it
+  // into a formula about the situation after t so that the history up to t
+  // need not be squared into the functions anymore. A literal [t][t_2]...
+  // becomes [t_2]..., a literal [x]... with non-ground x becomes
+  // x != t v ..., and the remaining literals with functions, which are about
+  // situations that are unreachable now, become true. The result is then
+  // simplified and false is returned iff it is true, in which case the
+  // formula may be dropped.
+  // The result is equivalent (for the situation after t) if the unreachable
+  // literals are in formulas of their own, as in the local-effect fragment,
+  // and a weakening otherwise.
+  // Actions are compared up to stripping, so t and the formula's actions may
+  // each be stripped or not.
+  // Precondition: Formula is objective and in NNF with actions pushed inwards.
+  // Reason: Every literal carries its own history.
+  bool Progress(const Formula& t) {
+    assert(readable().weakly_well_formed());
+    assert(readable().objective());
+    assert(readable().nnf());
+    assert(t.readable().ground() && t.head().term());
+    Abc::Symbol::List unstripped_t;
+    for (const Abc::Symbol& u : t) {
+      AppendUnstrippedTerm(u, &unstripped_t);
+    }
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
+    AppendProgressed(t.word_.readable(), unstripped_t, word_.readable().begin(), &symbols);
+    Reset(std::move(symbols));
+    Simplify();
+    return !truth(head());
+  }
+
+  // Progresses every formula of the knowledge base kb through the ground
+  // action t and removes those that become true. When kb is progressed after
+  // every executed action, it only talks about the current situation, so it
+  // does not grow with the history and need not be squared with it.
+  static void Progress(std::vector<Formula>* kb, const Formula& t) {
+    auto last = kb->begin();
+    for (auto it = kb->begin(); it != kb->end(); ++it) {
+      if (it->Progress(t)) {
+        if (it != last) {
+          *last = std::move(*it);
+        }
+        ++last;
+      }
+    }
+    kb->erase(last, kb->end());
+  }
+
   // Introduces new variables so that no variable is quantified twice.
   // If all_new is true, then every variable is replaced with a new one;
   // otherwise the first occurrences remain unaltered.
@@ -1079,100 +1617,34 @@ class Formula : private FormulaCommons {
   // negations, existentially) quantified variables.
   void Flatten() {
     assert(readable().weakly_well_formed());
-    struct NotMarker {
-      explicit NotMarker(bool neg, Scope scope) : neg(neg), scope(scope) {}
-      explicit NotMarker(Scope scope) : reset(true), scope(scope) {}
-      bool reset = false;
-      bool neg   = false;
-      Scope scope{};
-    };
-    std::vector<NotMarker> nots;
-    Scope::Observer scoper;
-    Abc::Symbol::Ref or_ref = end();
-    bool tolerate_fun = false;
-    for (auto it = begin(); it != end(); ) {
-      const bool pos = nots.empty() || !nots.back().neg;
-      switch (it->tag) {
-        case Abc::Symbol::kFun:
-          if (!tolerate_fun) {
-            const Abc::VarSymbol x = Abc::instance().CreateVar(it->u.f.sort());
-            it = word_.Insert(it, Abc::Symbol::Var(x));
-            const Abc::Symbol::Ref first = std::next(it);
-            const Abc::Symbol::Ref last = End(first);
-            Abc::Symbol::List symbols = word_.TakeOut(first, last);
-            symbols.push_back(Abc::Symbol::Var(x));
-            symbols.push_front(pos ? Abc::Symbol::NotEquals() : Abc::Symbol::Equals());
-            auto bt = word_.Insert(or_ref, pos ? Abc::Symbol::Forall(x) : Abc::Symbol::Exists(x));
-            while (--it != bt) {
-              scoper.Vomit(*it);
-            }
-            ++(or_ref->u.k);
-            word_.PutIn(std::next(or_ref), std::move(symbols));
-          }
-        case Abc::Symbol::kName:
-        case Abc::Symbol::kVar:
-          scoper.Munch(*it++);
-          tolerate_fun = false;
-          break;
-        case Abc::Symbol::kEquals:
-        case Abc::Symbol::kNotEquals:
-          or_ref = word_.Insert(it, pos ? Abc::Symbol::Or(1) : Abc::Symbol::And(1));
-          scoper.Munch(*or_ref);
-          scoper.Munch(*it++);
-          tolerate_fun = true;
-          break;
-        case Abc::Symbol::kAction:
-          or_ref = word_.Insert(it, pos ? Abc::Symbol::Or(1) : Abc::Symbol::And(1));
-          scoper.Munch(*or_ref);
-          scoper.Munch(*it++);
-          break;
-        case Abc::Symbol::kOr:
-        case Abc::Symbol::kAnd:
-        case Abc::Symbol::kStrippedFun:
-        case Abc::Symbol::kStrippedName:
-        case Abc::Symbol::kStrippedLit:
-          scoper.Munch(*it++);
-          break;
-        case Abc::Symbol::kNot:
-          nots.push_back(NotMarker(nots.empty() || !nots.back().neg, scoper.scope()));
-          scoper.Munch(*it++);
-          break;
-        case Abc::Symbol::kExists:
-        case Abc::Symbol::kForall:
-        case Abc::Symbol::kKnow:
-        case Abc::Symbol::kMaybe:
-        case Abc::Symbol::kBelieve:
-          scoper.Munch(*it++);
-          nots.push_back(NotMarker(scoper.scope()));
-          break;
-      }
-      while (!nots.empty() && !scoper.active(nots.back().scope)) {
-        nots.pop_back();
-      }
-    }
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
+    AppendFlattened(true, word_.readable().begin(), &symbols);
+    Reset(std::move(symbols));
     assert(readable().weakly_well_formed());
     assert(readable().strongly_well_formed());
   }
 
   // Pushes actions and negations inwards, pulls quantifiers out of dis- and
-  // conjunctions, pulls quantifiers out of dis- and conjunctions.
+  // conjunctions, and merges nested dis- and conjunctions.
   // Precondition: Formula is rectified.
   // Reasons: (1) We pull quantifiers out of dis- and conjunctions.
   //          (2) We push actions inwards.
   void PushInwards() {
     assert(readable().weakly_well_formed());
     struct AndOrMarker {
-      explicit AndOrMarker(Abc::Symbol::Ref ref, Scope scope) : ref(ref), scope(scope) {}
+      explicit AndOrMarker(Abc::Symbol s, Scope scope) : s(s), scope(scope) {}
       explicit AndOrMarker(Scope scope) : reset(true), scope(scope) {}
       bool reset = false;
-      Abc::Symbol::Ref ref{};
+      Abc::Symbol s{};
+      Abc::Symbol::List quantifiers{};
       Scope scope{};
     };
     struct ActionMarker {
-      explicit ActionMarker(Abc::Symbol::List symbols, Scope scope) : symbols(symbols), scope(scope) {}
+      explicit ActionMarker(Abc::RWord symbols, Scope scope) : symbols(symbols), scope(scope) {}
       explicit ActionMarker(Scope scope) : reset(true), scope(scope) {}
       bool reset = false;
-      Abc::Symbol::List symbols{};
+      Abc::RWord symbols{};
       Scope scope{};
     };
     struct NotMarker {
@@ -1186,87 +1658,112 @@ class Formula : private FormulaCommons {
     std::vector<ActionMarker> actions;
     std::vector<NotMarker> nots;
     Scope::Observer scoper;
+    // Every dis- or conjunction that is not reset collects its arguments in a
+    // buffer of its own, because quantifiers are pulled out in front of it
+    // until it is complete.
+    std::vector<Abc::Symbol::List> buffers(1);
+    buffers.back().reserve(word_.size());
     for (auto it = begin(); it != end(); ) {
+      Abc::Symbol::List& symbols = buffers.back();
+      const bool neg = !nots.empty() && nots.back().neg;
       switch (it->tag) {
         case Abc::Symbol::kVar:
         case Abc::Symbol::kFun:
         case Abc::Symbol::kName:
         case Abc::Symbol::kStrippedFun:
         case Abc::Symbol::kStrippedName:
+          symbols.push_back(*it);
           scoper.Munch(*it++);
           break;
         case Abc::Symbol::kEquals:
         case Abc::Symbol::kNotEquals:
-        case Abc::Symbol::kStrippedLit:
+        case Abc::Symbol::kStrippedLit: {
           if (andors.empty() || andors.back().reset) {
-            const Abc::Symbol::Ref last = word_.Insert(it, Abc::Symbol::Or(1));
-            scoper.Munch(*last);
-            andors.push_back(AndOrMarker(last, scoper.scope()));
+            symbols.push_back(Abc::Symbol::Or(1));
           }
-          {
-            Abc::Symbol::Ref pre = it;
-            for (auto sit = actions.rbegin(); sit != actions.rend() && !sit->reset; ++sit) {
-              pre = word_.Insert(pre, sit->symbols.begin(), sit->symbols.end());
-            }
+          auto ait = actions.end();
+          while (ait != actions.begin() && !std::prev(ait)->reset) {
+            --ait;
           }
-          if (!nots.empty() && nots.back().neg) {
-            switch (it->tag) {
-              case Abc::Symbol::kEquals:      it->tag = Abc::Symbol::kNotEquals; break;
-              case Abc::Symbol::kNotEquals:   it->tag = Abc::Symbol::kEquals; break;
-              case Abc::Symbol::kStrippedLit: it->u.a = it->u.a.flip(); break;
+          for (; ait != actions.end(); ++ait) {
+            symbols.insert(symbols.end(), ait->symbols.begin(), ait->symbols.end());
+          }
+          Abc::Symbol s = *it;
+          if (neg) {
+            switch (s.tag) {
+              case Abc::Symbol::kEquals:      s.tag = Abc::Symbol::kNotEquals; break;
+              case Abc::Symbol::kNotEquals:   s.tag = Abc::Symbol::kEquals; break;
+              case Abc::Symbol::kStrippedLit: s.u.a = s.u.a.flip(); break;
               default:                        assert(false); std::abort();
             }
           }
+          symbols.push_back(s);
           scoper.Munch(*it++);
           break;
+        }
         case Abc::Symbol::kKnow:
         case Abc::Symbol::kMaybe:
         case Abc::Symbol::kBelieve:
-          scoper.Munch(*it++);
           andors.push_back(AndOrMarker(scoper.scope()));
           actions.push_back(ActionMarker(scoper.scope()));
           nots.push_back(NotMarker(scoper.scope()));
+          symbols.push_back(*it);
+          scoper.Munch(*it++);
           break;
         case Abc::Symbol::kAction: {
-          auto first = it;  // we're taking out the kAction symbol plus the action
-          auto last = End(std::next(it));
+          const auto first = it;  // we're taking the kAction symbol plus the action
+          const auto last = End(std::next(it));
           it = last;
-          actions.push_back(ActionMarker(word_.TakeOut(first, last), scoper.scope()));
+          actions.push_back(ActionMarker(Abc::RWord(first, last), scoper.scope()));
           break;
         }
         case Abc::Symbol::kNot:
-          nots.push_back(NotMarker(nots.empty() || !nots.back().neg, scoper.scope()));
-          it = word_.Erase(it);
+          nots.push_back(NotMarker(!neg, scoper.scope()));
+          ++it;
           break;
         case Abc::Symbol::kExists:
         case Abc::Symbol::kForall: {
-          if (!nots.empty() && nots.back().neg) {
-            it->tag = it->tag == Abc::Symbol::kExists ? Abc::Symbol::kForall : Abc::Symbol::kExists;
+          Abc::Symbol s = *it;
+          if (neg) {
+            s.tag = s.tag == Abc::Symbol::kExists ? Abc::Symbol::kForall : Abc::Symbol::kExists;
           }
           scoper.Munch(*it++);
-          if (!andors.empty()) {
-            const AndOrMarker& aom = andors.back();
-            if (!aom.reset) {
-              word_.Move(andors.back().ref, std::prev(it));
-            } else {
+          if (!andors.empty() && !andors.back().reset) {
+            andors.back().quantifiers.push_back(s);
+          } else {
+            symbols.push_back(s);
+            if (!andors.empty()) {
               andors.push_back(AndOrMarker(scoper.scope()));
             }
           }
           break;
         }
         case Abc::Symbol::kOr:
-        case Abc::Symbol::kAnd:
-          if (!andors.empty() && !andors.back().reset && andors.back().ref->tag == it->tag) {
-            andors.back().ref->u.k += it->u.k - 1;
-            scoper.Munch(*it);
-            it = word_.Erase(it);
+        case Abc::Symbol::kAnd: {
+          Abc::Symbol s = *it;
+          if (neg) {
+            s.tag = s.tag == Abc::Symbol::kOr ? Abc::Symbol::kAnd : Abc::Symbol::kOr;
+          }
+          if (!andors.empty() && !andors.back().reset && (andors.back().s.tag == s.tag || s.u.k == 1)) {
+            andors.back().s.u.k += s.u.k - 1;
           } else {
-            andors.push_back(AndOrMarker(it, scoper.scope()));
-            scoper.Munch(*it++);
+            andors.push_back(AndOrMarker(s, scoper.scope()));
+            buffers.emplace_back();
           }
+          scoper.Munch(*it++);
           break;
+        }
       }
       while (!andors.empty() && !scoper.active(andors.back().scope)) {
+        const AndOrMarker& aom = andors.back();
+        if (!aom.reset) {
+          Abc::Symbol::List args = std::move(buffers.back());
+          buffers.pop_back();
+          Abc::Symbol::List& parent = buffers.back();
+          parent.insert(parent.end(), aom.quantifiers.begin(), aom.quantifiers.end());
+          parent.push_back(aom.s);
+          parent.insert(parent.end(), args.begin(), args.end());
+        }
         andors.pop_back();
       }
       while (!actions.empty() && !scoper.active(actions.back().scope)) {
@@ -1276,125 +1773,107 @@ class Formula : private FormulaCommons {
         nots.pop_back();
       }
     }
+    assert(buffers.size() == 1);
+    Reset(std::move(buffers.back()));
     assert(readable().nnf());
     assert(readable().weakly_well_formed());
   }
 
+  // Simplifies the formula without changing its meaning. Literals t = t and
+  // equalities of distinct names are replaced with truth or falsity, that is,
+  // an empty con- or disjunction, which is then propagated. Furthermore,
+  // nested dis- and conjunctions are merged or unwrapped, duplicate and
+  // absorbed arguments are removed, and quantifiers are dropped whose
+  // variable does not occur in their scope.
+  // Should be called before Ground(), which would otherwise multiply the junk.
+  void Simplify() {
+    assert(readable().weakly_well_formed());
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
+    AppendSimplified(word_.readable().begin(), &symbols);
+    Reset(std::move(symbols));
+    assert(readable().weakly_well_formed());
+  }
+
   // Replaces existential and universal quantifiers with disjunctions or
   // conjunctions, respectively, over the names.
+  // See Grounder for a variant that shares equal subformulas.
   template<typename UnaryFunction>
   void Ground(UnaryFunction sort_names) {
-    using Container = decltype(std::declval<UnaryFunction>()(Abc::Sort()));
-    using Iterator = decltype(std::declval<const Container>().begin());
-    struct SubstitutionMarker {
-      explicit SubstitutionMarker(Abc::VarSymbol x, Iterator n_begin, Iterator n_end, Scope scope)
-          : x(x), n_begin(n_begin), n_end(n_end), scope(scope) {}
-      Abc::VarSymbol x{};
-      Iterator n_begin{};
-      Iterator n_end{};
-      Scope scope{};
-    };
-    std::vector<SubstitutionMarker> markers;
     Abc::DenseMap<Abc::VarSymbol, class Name> map;
-    Scope::Observer scoper;
-    for (auto it = begin(); it != end(); ++it) {
-      scoper.Munch(*it);
-      if (it->tag == Abc::Symbol::kExists || it->tag == Abc::Symbol::kForall) {
-        const Abc::VarSymbol x = it->u.x;
-        const Container names = sort_names(x.sort());
-        const int arity = int(std::distance(names.begin(), names.end()));
-        const Abc::Symbol::Ref first = std::next(it);
-        Abc::Symbol::Ref before = End(first);
-        Abc::Symbol::List subformula = word_.TakeOut(first, before);
-        for (int i = arity; i > 0; --i) {
-          Abc::Symbol::List formula = subformula;
-          const Abc::Symbol::Ref new_before = formula.begin();
-          word_.PutIn(before, std::move(formula));
-          before = new_before;
-        }
-        if (arity > 0) {
-          markers.push_back(SubstitutionMarker(x, names.begin(), names.end(), scoper.scope()));
-          map[x] = *names.begin();
-        }
-        *it = it->tag == Abc::Symbol::kExists ? Abc::Symbol::Or(arity) : Abc::Symbol::And(arity);
-      } else if (it->tag == Abc::Symbol::kVar) {
-        const Abc::VarSymbol x = it->u.x;
-        if (!map[x].null()) {
-          *it = Abc::Symbol::StrippedName(map[x]);
-        }
-      }
-      for (int i = int(markers.size()) - 1; i >= 0 && !scoper.active(markers[i].scope); --i) {
-        markers[i].scope = scoper.scope();
-        ++markers[i].n_begin;
-        if (markers[i].n_begin == markers[i].n_end) {
-          markers.pop_back();
-        } else {
-          map[markers[i].x] = *markers[i].n_begin;
-        }
-      }
-    }
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
+    AppendGrounded(&sort_names, &map, word_.readable().begin(), &symbols);
+    Reset(std::move(symbols));
   }
 
   // Replaces primitive terms, names, and primitive literals with their
-  // stripped version, that is, Fun, Name, Lit.
+  // stripped version, that is, Fun, Name, Lit. A term with a nested function
+  // or a variable is not primitive and stays unstripped, though its primitive
+  // subterms are stripped; Flatten() and Ground() first to strip everything.
   void Strip() {
     assert(readable().weakly_well_formed());
     struct TermMarker {
-      explicit TermMarker(Abc::Symbol::Ref ref, Scope scope) : ref(ref), scope(scope) {}
+      explicit TermMarker(int begin, Scope scope) : begin(begin), scope(scope) {}
       bool ok = true;
-      Abc::Symbol::Ref ref{};
+      int begin;
       Scope scope{};
     };
     std::vector<TermMarker> terms;
     Scope::Observer scoper;
-    Abc::Symbol::Ref last_eq = end();
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
+    int last_eq = -1;
     for (auto it = begin(); it != end(); ) {
       if (it->tag == Abc::Symbol::kFun) {
         for (TermMarker& tm : terms) {
-          tm.ok &= tm.ref->term();
+          tm.ok = false;  // Alphabet::Strip() only takes names as arguments
         }
-        terms.push_back(TermMarker(it, scoper.scope()));
+        terms.push_back(TermMarker(symbols.size(), scoper.scope()));
       } else if (it->tag == Abc::Symbol::kName) {
-        terms.push_back(TermMarker(it, scoper.scope()));
+        terms.push_back(TermMarker(symbols.size(), scoper.scope()));
       } else if (it->tag == Abc::Symbol::kVar) {
         for (TermMarker& tm : terms) {
           tm.ok = false;
         }
       } else if (it->tag == Abc::Symbol::kEquals || it->tag == Abc::Symbol::kNotEquals) {
-        last_eq = it;
+        last_eq = symbols.size();
       }
+      symbols.push_back(*it);
       scoper.Munch(*it++);
       while (!terms.empty() && !scoper.active(terms.back().scope)) {
         const TermMarker& tm = terms.back();
         if (tm.ok) {
-          Abc::Word w = Abc::Word(word_.TakeOut(tm.ref, it));
-          const Abc::Symbol s = Abc::instance().Strip(std::move(w));
-          word_.Insert(it, s);
+          Abc::Word w = Abc::Word(symbols.begin() + tm.begin, symbols.end());
+          symbols.resize(tm.begin);
+          symbols.push_back(Abc::instance().Strip(std::move(w)));
         }
         terms.pop_back();
       }
-      Abc::Symbol::Ref lhs;
-      Abc::Symbol::Ref rhs;
-      if (last_eq != end() && (lhs = std::next(last_eq)) != end() && (rhs = std::next(lhs)) != end()) {
-        assert(last_eq->tag == Abc::Symbol::kEquals || last_eq->tag == Abc::Symbol::kNotEquals);
-        if (lhs->stripped() && lhs->term() && rhs->stripped() && rhs->term()) {
+      if (last_eq >= 0 && int(symbols.size()) == last_eq + 3) {
+        const Abc::Symbol eq  = symbols[last_eq];
+        const Abc::Symbol lhs = symbols[last_eq + 1];
+        const Abc::Symbol rhs = symbols[last_eq + 2];
+        assert(eq.tag == Abc::Symbol::kEquals || eq.tag == Abc::Symbol::kNotEquals);
+        if (lhs.stripped() && lhs.term() && rhs.stripped() && rhs.term()) {
           Abc::Symbol s;
-          const bool pos = last_eq->tag == Abc::Symbol::kEquals;
-          if (lhs->name() && rhs->name()) {
-            s = (lhs->u.n_s == rhs->u.n_s) == pos ? Abc::Symbol::And(0) : Abc::Symbol::Or(0);
-          } else if (lhs->sort() != rhs->sort()) {
+          const bool pos = eq.tag == Abc::Symbol::kEquals;
+          if (lhs.name() && rhs.name()) {
+            s = (lhs.u.n_s == rhs.u.n_s) == pos ? Abc::Symbol::And(0) : Abc::Symbol::Or(0);
+          } else if (lhs.sort() != rhs.sort()) {
             s = pos ? Abc::Symbol::Or(0) : Abc::Symbol::And(0);
           } else {
-            const class Fun f = lhs->fun() ? lhs->u.f_s : rhs->u.f_s;
-            const class Name n = rhs->name() ? rhs->u.n_s : lhs->u.n_s;
+            const class Fun f = lhs.fun() ? lhs.u.f_s : rhs.u.f_s;
+            const class Name n = rhs.name() ? rhs.u.n_s : lhs.u.n_s;
             s = Abc::Symbol::Lit(pos ? Lit::Eq(f, n) : Lit::Neq(f, n));
           }
-          it = word_.Erase(last_eq, std::next(rhs));
-          word_.Insert(it, s);
-          last_eq = end();
+          symbols.resize(last_eq);
+          symbols.push_back(s);
+          last_eq = -1;
         }
       }
     }
+    Reset(std::move(symbols));
     assert(readable().weakly_well_formed());
   }
 
@@ -1404,30 +1883,34 @@ class Formula : private FormulaCommons {
   void Reduce(UnaryPredicate select = UnaryPredicate(), UnaryFunction reduce = UnaryFunction()) {
     assert(readable().weakly_well_formed());
     struct Marker {
-      explicit Marker(Abc::Symbol::Ref ref, Scope scope) : ref(ref), scope(scope) {}
-      Abc::Symbol::Ref ref{};
+      explicit Marker(int begin, Scope scope) : begin(begin), scope(scope) {}
+      int begin;
       Scope scope{};
     };
     std::vector<Marker> markers;
     Scope::Observer scoper;
+    Abc::Symbol::List symbols;
+    symbols.reserve(word_.size());
     for (auto it = begin(); it != end(); ) {
       if (select(*it)) {
-        markers.push_back(Marker(it, scoper.scope()));
+        markers.push_back(Marker(symbols.size(), scoper.scope()));
       }
+      symbols.push_back(*it);
       scoper.Munch(*it++);
       while (!markers.empty() && !scoper.active(markers.back().scope)) {
-        const Abc::Symbol::Ref begin = markers.back().ref;
-        Formula f = reduce(RFormula(begin, it));
-        it = word_.Erase(begin, it);
-        word_.PutIn(it, std::move(f.word_));
+        const int begin = markers.back().begin;
+        Formula f = reduce(RFormula(symbols.begin() + begin, symbols.end()));
+        symbols.resize(begin);
+        symbols.insert(symbols.end(), f.begin(), f.end());
         markers.pop_back();
       }
     }
+    Reset(std::move(symbols));
     assert(readable().weakly_well_formed());
   }
 
  private:
-  explicit Formula(const Abc::Symbol s)                                                  { word_.Insert(end(), s); }
+  explicit Formula(const Abc::Symbol s)                                                  { word_.Insert(end(), s); sizes_.push_back(1); }
   explicit Formula(const Abc::Symbol s, Formula&& f)                        : Formula(s) { assert(s.arity() == 1); AddArg(f); }
   explicit Formula(const Abc::Symbol s, const Formula& f)                   : Formula(s) { assert(s.arity() == 1); AddArg(f); }
   explicit Formula(const Abc::Symbol s, Formula&& f, Formula&& g)           : Formula(s) { assert(s.arity() == 2); AddArg(f); AddArg(g); }
@@ -1446,7 +1929,9 @@ class Formula : private FormulaCommons {
             tag() == Abc::Symbol::kFun || tag() == Abc::Symbol::kName ||
             (tag() == Abc::Symbol::kAction && word_.size() == 1)) == f.head().term());
     assert(tag() != Abc::Symbol::kName || !head().u.n.sort().rigid() || !f.head().u.n.sort().rigid());
-    word_.PutIn(end(), std::move(f.word_));
+    word_.Insert(end(), f.begin(), f.end());
+    sizes_[0] += f.sizes_[0];
+    sizes_.insert(sizes_.end(), f.sizes_.begin(), f.sizes_.end());
   }
 
   void AddArg(const Formula& f) {
@@ -1455,9 +1940,391 @@ class Formula : private FormulaCommons {
             (tag() == Abc::Symbol::kAction && word_.size() == 1)) == f.head().term());
     assert(tag() != Abc::Symbol::kName || !head().u.n.sort().rigid() || !f.head().u.n.sort().rigid());
     word_.Insert(end(), f.begin(), f.end());
+    sizes_[0] += f.sizes_[0];
+    sizes_.insert(sizes_.end(), f.sizes_.begin(), f.sizes_.end());
+  }
+
+  void Reset(Abc::Symbol::List&& symbols) {
+    word_ = Abc::Word(std::move(symbols));
+    sizes_ = SubtreeSizes(word_.begin(), word_.end());
+  }
+
+  static bool truth(const Abc::Symbol s)   { return s.tag == Abc::Symbol::kAnd && s.u.k == 0; }
+  static bool falsity(const Abc::Symbol s) { return s.tag == Abc::Symbol::kOr && s.u.k == 0; }
+
+  // Returns 1 if the terms [first, middle) and [middle, last) are identical,
+  // 0 if they are distinct names or of different sorts, and -1 otherwise.
+  static int CompareTerms(const Abc::Symbol::CRef first, const Abc::Symbol::CRef middle, const Abc::Symbol::CRef last) {
+    if (std::equal(first, middle, middle, last)) {
+      return 1;
+    }
+    if (first->sort() != middle->sort()) {
+      return 0;
+    }
+    const auto name = [first](const Abc::Symbol& s) { return s.tag == first->tag; };
+    if ((first->tag == Abc::Symbol::kName || first->tag == Abc::Symbol::kStrippedName) &&
+        std::all_of(first, last, name)) {
+      return 0;
+    }
+    return -1;
+  }
+
+  // Appends the simplified formula that starts at it to symbols and returns
+  // the end of that formula.
+  static Abc::Symbol::CRef AppendSimplified(Abc::Symbol::CRef it, Abc::Symbol::List* symbols) {
+    const int begin = symbols->size();
+    const Abc::Symbol s = *it++;
+    switch (s.tag) {
+      case Abc::Symbol::kEquals:
+      case Abc::Symbol::kNotEquals: {
+        const Abc::Symbol::CRef middle = End(it);
+        const Abc::Symbol::CRef last = End(middle);
+        const int cmp = CompareTerms(it, middle, last);
+        if (cmp < 0) {
+          symbols->insert(symbols->end(), std::prev(it), last);
+        } else {
+          symbols->push_back((cmp == 1) == (s.tag == Abc::Symbol::kEquals) ? Abc::Symbol::And(0) : Abc::Symbol::Or(0));
+        }
+        return last;
+      }
+      case Abc::Symbol::kStrippedLit:
+        symbols->push_back(s);
+        return it;
+      case Abc::Symbol::kNot:
+        symbols->push_back(s);
+        it = AppendSimplified(it, symbols);
+        if (truth((*symbols)[begin + 1]) || falsity((*symbols)[begin + 1])) {
+          const bool neg = truth((*symbols)[begin + 1]);
+          symbols->resize(begin);
+          symbols->push_back(neg ? Abc::Symbol::Or(0) : Abc::Symbol::And(0));
+        }
+        return it;
+      case Abc::Symbol::kExists:
+      case Abc::Symbol::kForall: {
+        symbols->push_back(s);
+        it = AppendSimplified(it, symbols);
+        const auto bound = [s](const Abc::Symbol& t) { return t.tag == Abc::Symbol::kVar && t.u.x == s.u.x; };
+        if (std::none_of(symbols->begin() + begin + 1, symbols->end(), bound)) {
+          symbols->erase(symbols->begin() + begin);
+        }
+        return it;
+      }
+      case Abc::Symbol::kAction: {
+        const Abc::Symbol::CRef body = End(it);
+        symbols->insert(symbols->end(), std::prev(it), body);
+        const int body_begin = symbols->size();
+        it = AppendSimplified(body, symbols);
+        if (truth((*symbols)[body_begin]) || falsity((*symbols)[body_begin])) {
+          symbols->erase(symbols->begin() + begin, symbols->begin() + body_begin);
+        }
+        return it;
+      }
+      case Abc::Symbol::kKnow:
+      case Abc::Symbol::kMaybe:
+      case Abc::Symbol::kBelieve:
+        symbols->push_back(s);
+        for (int i = 0; i < s.arity(); ++i) {
+          it = AppendSimplified(it, symbols);
+        }
+        return it;
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kAnd: {
+        const Abc::Symbol::Tag dual = s.tag == Abc::Symbol::kOr ? Abc::Symbol::kAnd : Abc::Symbol::kOr;
+        Abc::Symbol::List args;
+        for (int i = 0; i < s.arity(); ++i) {
+          it = AppendSimplified(it, &args);
+        }
+        // Split the arguments, merge nested dis- or conjunctions, and look for
+        // truth in a disjunction or falsity in a conjunction.
+        std::vector<std::pair<int, int>> ranges;
+        for (int i = 0; i < int(args.size()); ) {
+          const Abc::Symbol t = args[i];
+          if (t.tag == dual && t.u.k == 0) {
+            symbols->push_back(t);
+            return it;
+          } else if (t.tag == s.tag) {
+            ++i;
+          } else {
+            const int j = End(args.cbegin() + i) - args.cbegin();
+            ranges.push_back(std::make_pair(i, j));
+            i = j;
+          }
+        }
+        // The arguments of a con- or disjunction of dis- or conjunctions are
+        // sets of elements; an argument is absorbed by another one whose
+        // elements it contains (and which comes first in case of a tie).
+        const auto equal = [&args](const std::pair<int, int> r1, const std::pair<int, int> r2) {
+          return std::equal(args.begin() + r1.first, args.begin() + r1.second,
+                            args.begin() + r2.first, args.begin() + r2.second);
+        };
+        std::vector<std::vector<std::pair<int, int>>> elems;
+        elems.reserve(ranges.size());
+        for (const std::pair<int, int>& r : ranges) {
+          elems.emplace_back();
+          if (args[r.first].tag == dual) {
+            for (int i = r.first + 1; i < r.second; ) {
+              const int j = End(args.cbegin() + i) - args.cbegin();
+              elems.back().push_back(std::make_pair(i, j));
+              i = j;
+            }
+          } else {
+            elems.back().push_back(r);
+          }
+        }
+        const auto subset = [&equal, &elems](const int i, const int j) {
+          for (const std::pair<int, int>& r1 : elems[i]) {
+            if (std::none_of(elems[j].begin(), elems[j].end(), [&](const std::pair<int, int> r2) { return equal(r1, r2); })) {
+              return false;
+            }
+          }
+          return true;
+        };
+        std::vector<bool> absorbed(ranges.size(), false);
+        for (int i = 0; i < int(ranges.size()); ++i) {
+          for (int j = 0; j < int(ranges.size()) && !absorbed[i]; ++j) {
+            absorbed[i] = j != i && subset(j, i) && (j < i || !subset(i, j));
+          }
+        }
+        symbols->push_back(s);
+        (*symbols)[begin].u.k = 0;
+        for (int i = 0; i < int(ranges.size()); ++i) {
+          if (!absorbed[i]) {
+            symbols->insert(symbols->end(), args.begin() + ranges[i].first, args.begin() + ranges[i].second);
+            ++(*symbols)[begin].u.k;
+          }
+        }
+        // A single argument needs no wrapper.
+        if ((*symbols)[begin].u.k == 1) {
+          symbols->erase(symbols->begin() + begin);
+        }
+        return it;
+      }
+      case Abc::Symbol::kFun:
+      case Abc::Symbol::kName:
+      case Abc::Symbol::kVar:
+      case Abc::Symbol::kStrippedFun:
+      case Abc::Symbol::kStrippedName:
+        assert(false);
+        std::abort();
+    }
+    std::abort();
+  }
+
+  // Appends the term s to symbols, with every stripped term replaced with its
+  // unstripped version.
+  static void AppendUnstrippedTerm(const Abc::Symbol& s, Abc::Symbol::List* symbols) {
+    if (s.stripped()) {
+      for (const Abc::Symbol& u : Abc::instance().Unstrip(s)) {
+        AppendUnstrippedTerm(u, symbols);
+      }
+    } else {
+      symbols->push_back(s);
+    }
+  }
+
+  // Appends the formula that starts at it, progressed through t, to symbols
+  // and returns the end of that formula. The actions in the formula are
+  // compared with unstripped_t, the unstripped version of t.
+  static Abc::Symbol::CRef AppendProgressed(const Abc::RWord t,
+                                            const Abc::Symbol::List& unstripped_t,
+                                            Abc::Symbol::CRef it,
+                                            Abc::Symbol::List* symbols) {
+    const Abc::Symbol s = *it;
+    switch (s.tag) {
+      case Abc::Symbol::kAction: {
+        const Abc::Symbol::CRef term = std::next(it);
+        const Abc::Symbol::CRef body = End(term);
+        const Abc::Symbol::CRef last = End(it);
+        const auto var = [](const Abc::Symbol& u) { return u.var(); };
+        Abc::Symbol::List unstripped_term;
+        for (auto jt = term; jt != body; ++jt) {
+          AppendUnstrippedTerm(*jt, &unstripped_term);
+        }
+        if (unstripped_term == unstripped_t) {
+          symbols->insert(symbols->end(), body, last);
+        } else if (std::any_of(term, body, var)) {
+          symbols->push_back(Abc::Symbol::Or(2));
+          symbols->push_back(Abc::Symbol::NotEquals());
+          symbols->insert(symbols->end(), term, body);
+          symbols->insert(symbols->end(), t.begin(), t.end());
+          symbols->insert(symbols->end(), body, last);
+        } else {
+          symbols->push_back(Abc::Symbol::And(0));
+        }
+        return last;
+      }
+      case Abc::Symbol::kEquals:
+      case Abc::Symbol::kNotEquals:
+      case Abc::Symbol::kStrippedLit: {
+        const Abc::Symbol::CRef last = End(it);
+        const auto fluent = [](const Abc::Symbol& u) { return u.fun() || u.tag == Abc::Symbol::kStrippedLit; };
+        if (std::any_of(it, last, fluent)) {
+          symbols->push_back(Abc::Symbol::And(0));
+        } else {
+          symbols->insert(symbols->end(), it, last);
+        }
+        return last;
+      }
+      case Abc::Symbol::kExists:
+      case Abc::Symbol::kForall:
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kAnd:
+        symbols->push_back(s);
+        ++it;
+        for (int i = 0; i < s.arity(); ++i) {
+          it = AppendProgressed(t, unstripped_t, it, symbols);
+        }
+        return it;
+      case Abc::Symbol::kNot:
+      case Abc::Symbol::kKnow:
+      case Abc::Symbol::kMaybe:
+      case Abc::Symbol::kBelieve:
+      case Abc::Symbol::kFun:
+      case Abc::Symbol::kName:
+      case Abc::Symbol::kVar:
+      case Abc::Symbol::kStrippedFun:
+      case Abc::Symbol::kStrippedName:
+        assert(false);
+        std::abort();
+    }
+    std::abort();
+  }
+
+  // Appends the grounded formula that starts at it to symbols and returns the
+  // end of that formula. A quantified formula is copied once for every name of
+  // the variable's sort, with the variable mapped to that name.
+  template<typename UnaryFunction>
+  static Abc::Symbol::CRef AppendGrounded(UnaryFunction* sort_names,
+                                          Abc::DenseMap<Abc::VarSymbol, class Name>* map,
+                                          Abc::Symbol::CRef it,
+                                          Abc::Symbol::List* symbols) {
+    const Abc::Symbol s = *it++;
+    if (s.tag == Abc::Symbol::kExists || s.tag == Abc::Symbol::kForall) {
+      const Abc::VarSymbol x = s.u.x;
+      const auto& names = (*sort_names)(x.sort());
+      const int arity = int(std::distance(names.begin(), names.end()));
+      symbols->push_back(s.tag == Abc::Symbol::kExists ? Abc::Symbol::Or(arity) : Abc::Symbol::And(arity));
+      if (arity == 0) {
+        return End(it);
+      }
+      const class Name old = (*map)[x];
+      Abc::Symbol::CRef last = it;
+      for (const class Name n : names) {
+        (*map)[x] = n;
+        last = AppendGrounded(sort_names, map, it, symbols);
+      }
+      (*map)[x] = old;
+      return last;
+    } else if (s.tag == Abc::Symbol::kVar) {
+      const class Name n = (*map)[s.u.x];
+      symbols->push_back(!n.null() ? Abc::Symbol::StrippedName(n) : s);
+      return it;
+    } else {
+      symbols->push_back(s);
+      for (int i = 0; i < s.arity(); ++i) {
+        it = AppendGrounded(sort_names, map, it, symbols);
+      }
+      return it;
+    }
+  }
+
+  // Appends the flattened formula that starts at it to symbols and returns the
+  // end of that formula. Every literal and action is wrapped in a dis- or
+  // conjunction, which takes a new literal for every function that is pulled
+  // out.
+  static Abc::Symbol::CRef AppendFlattened(const bool pos, Abc::Symbol::CRef it, Abc::Symbol::List* symbols) {
+    const Abc::Symbol s = *it++;
+    switch (s.tag) {
+      case Abc::Symbol::kEquals:
+      case Abc::Symbol::kNotEquals: {
+        const Abc::Symbol::CRef last = End(std::prev(it));
+        AppendFlattenedAtom(pos, std::prev(it), last, symbols);
+        return last;
+      }
+      case Abc::Symbol::kAction: {
+        const Abc::Symbol::CRef last = End(it);
+        return AppendFlattened(AppendFlattenedAtom(pos, std::prev(it), last, symbols), last, symbols);
+      }
+      case Abc::Symbol::kStrippedLit:
+        symbols->push_back(s);
+        return it;
+      case Abc::Symbol::kNot:
+        symbols->push_back(s);
+        return AppendFlattened(!pos, it, symbols);
+      case Abc::Symbol::kExists:
+      case Abc::Symbol::kForall:
+      case Abc::Symbol::kKnow:
+      case Abc::Symbol::kMaybe:
+      case Abc::Symbol::kBelieve:
+        symbols->push_back(s);
+        for (int i = 0; i < s.arity(); ++i) {
+          it = AppendFlattened(true, it, symbols);
+        }
+        return it;
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kAnd:
+        symbols->push_back(s);
+        for (int i = 0; i < s.arity(); ++i) {
+          it = AppendFlattened(pos, it, symbols);
+        }
+        return it;
+      case Abc::Symbol::kFun:
+      case Abc::Symbol::kName:
+      case Abc::Symbol::kVar:
+      case Abc::Symbol::kStrippedFun:
+      case Abc::Symbol::kStrippedName:
+        assert(false);
+        std::abort();
+    }
+    std::abort();
+  }
+
+  // Appends the flattened literal or action operator [first, last) to symbols.
+  // In the case of an action, the flattened body is expected to follow, and
+  // the returned polarity is the one in which it is to be flattened.
+  // The first function that is neither the left-hand side of a literal nor
+  // flat already is replaced with a new variable x, which is bound by a new
+  // quantifier, and the literal f(...) != x is added.
+  static bool AppendFlattenedAtom(const bool pos,
+                                  const Abc::Symbol::CRef first,
+                                  const Abc::Symbol::CRef last,
+                                  Abc::Symbol::List* symbols) {
+    bool tolerate_fun = false;
+    Abc::Symbol::CRef it = first;
+    for (; it != last; ++it) {
+      if (it->tag == Abc::Symbol::kEquals || it->tag == Abc::Symbol::kNotEquals) {
+        tolerate_fun = true;
+      } else if (it->tag == Abc::Symbol::kFun && !tolerate_fun) {
+        break;
+      } else if (it->tag == Abc::Symbol::kFun || it->tag == Abc::Symbol::kName || it->tag == Abc::Symbol::kVar) {
+        tolerate_fun = false;
+      }
+    }
+    if (it == last) {
+      symbols->push_back(pos ? Abc::Symbol::Or(1) : Abc::Symbol::And(1));
+      symbols->insert(symbols->end(), first, last);
+      return pos;
+    }
+    const Abc::VarSymbol x = Abc::instance().CreateVar(it->u.f.sort());
+    const Abc::Symbol::CRef term_last = End(it);
+    symbols->push_back(pos ? Abc::Symbol::Forall(x) : Abc::Symbol::Exists(x));
+    symbols->push_back(pos ? Abc::Symbol::Or(2) : Abc::Symbol::And(2));
+    Abc::Symbol::List term_lit;
+    term_lit.reserve(std::distance(it, term_last) + 2);
+    term_lit.push_back(pos ? Abc::Symbol::NotEquals() : Abc::Symbol::Equals());
+    term_lit.insert(term_lit.end(), it, term_last);
+    term_lit.push_back(Abc::Symbol::Var(x));
+    AppendFlattenedAtom(true, term_lit.cbegin(), term_lit.cend(), symbols);
+    Abc::Symbol::List atom;
+    atom.reserve(std::distance(first, last));
+    atom.insert(atom.end(), first, it);
+    atom.push_back(Abc::Symbol::Var(x));
+    atom.insert(atom.end(), term_last, last);
+    return AppendFlattenedAtom(true, atom.cbegin(), atom.cend(), symbols);
   }
 
-  Abc::Word word_;
+  Abc::Word        word_;
+  std::vector<int> sizes_{};
 };
 
 }  // namespace limbo
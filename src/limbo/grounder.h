@@ -0,0 +1,730 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Grounder grounds formulas into a hash-consed DAG: every node is a symbol
+// together with the ids of its argument nodes, and structurally equal
+// subformulas share a single node. A subformula is grounded once per binding
+// of its free variables rather than once per copy of the enclosing formula,
+// and literals are stripped as soon as they are ground. Clauses can be read
+// off the DAG without expanding it into a Formula.
+//
+// For formulas that are conjunctions of disjunctions already before grounding,
+// StreamClauses() avoids the DAG altogether: it instantiates the quantifiers
+// one binding at a time and passes every clause to a sink as soon as it is
+// complete, so that only a single clause is kept in memory.
+//
+// Ground formulas that are not in CNF are translated by
+// DefinitionalClauses(). Conjuncts whose CNF is small are distributed;
+// larger ones are translated in the style of Tseitin and Plaisted-Greenbaum:
+// every nested con- or disjunction is named by a new literal p = T, where p
+// is an auxiliary function. Since nodes are hash-consed, equal subformulas
+// share their auxiliary literal. Definitions preserve satisfiability but not
+// belief levels: in limited belief, the auxiliary literals need to be split
+// like ordinary ones, so a definitional translation may only be believed at
+// a higher level than its distributed counterpart.
+
+#ifndef LIMBO_GROUNDER_H_
+#define LIMBO_GROUNDER_H_
+
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <limbo/formula.h>
+#include <limbo/lit.h>
+#include <limbo/internal/arena.h>
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+
+class Grounder {
+ public:
+  using Abc    = Alphabet;
+  using node_t = internal::ArenaSet<int>::id_t;
+  using Args   = internal::ArenaSet<int>::Range;
+
+  Grounder() = default;
+
+  Grounder(const Grounder&)            = default;
+  Grounder& operator=(const Grounder&) = default;
+  Grounder(Grounder&&)                 = default;
+  Grounder& operator=(Grounder&&)      = default;
+
+  // Grounds f, whose quantifiers range over sort_names(sort), and returns its
+  // root node. Nodes are shared with earlier calls.
+  template<typename UnaryFunction>
+  node_t Ground(const RFormula& f, UnaryFunction sort_names) {
+    assert(f.weakly_well_formed());
+    Context ctx(f);
+    InitFreeVars(&ctx, f);
+    memo_keys_.Clear();
+    memo_nodes_.clear();
+    return GroundNode(&sort_names, &ctx, f);
+  }
+
+  int size() const { return heads_.size(); }
+
+  const Abc::Symbol& head(const node_t v) const { return heads_[v]; }
+
+  Args args(const node_t v) const {
+    const Args r = nodes_[v];
+    return Args(r.begin() + kHeaderSize, r.end());
+  }
+
+  // Expands the DAG below v into a tree, which may be exponentially larger.
+  Formula Expand(const node_t v) const {
+    Abc::Symbol::List symbols;
+    AppendExpanded(v, &symbols);
+    return Formula(Abc::Word(std::move(symbols)));
+  }
+
+  // Passes every clause of v, which needs to be a stripped conjunction of
+  // disjunctions of literals, as std::vector<Lit> to sink. A clause that is
+  // shared by several conjunctions is passed only once, and valid clauses are
+  // skipped. Returns false without passing any clause if v is not in CNF.
+  template<typename ClauseSink>
+  bool Clauses(const node_t v, ClauseSink sink) const {
+    std::vector<char> seen(size(), 0);
+    if (!CheckConjunction(v, &seen)) {
+      return false;
+    }
+    std::fill(seen.begin(), seen.end(), 0);
+    std::vector<Lit> clause;
+    EmitConjunction(v, &seen, &clause, &sink);
+    return true;
+  }
+
+  // Passes clauses that are equisatisfiable with v, which needs to be a ground
+  // and stripped formula built from literals, negation, con- and disjunction,
+  // as std::vector<Lit> to sink. The top-level conjunctions are kept, and a
+  // conjunct is distributed if its CNF has at most max_distributed() clauses.
+  // In every other conjunct, the top-level disjunctions are kept and every
+  // other compound subformula is replaced with an auxiliary literal, and only
+  // the implications that are needed for the subformula's polarity are added.
+  // Definitions are reused across calls. Returns false without passing any
+  // clause if v is not of that shape.
+  template<typename ClauseSink>
+  bool DefinitionalClauses(const node_t v, ClauseSink sink) {
+    std::vector<char> seen(size(), 0);
+    if (!CheckPropositional(v, &seen)) {
+      return false;
+    }
+    aux_.resize(size());
+    defined_.resize(size());
+    cnf_sizes_.assign(2 * size(), -1);
+    std::fill(seen.begin(), seen.end(), 0);
+    std::vector<Lit> clause;
+    DefineConjunction(v, &seen, &clause, &sink);
+    return true;
+  }
+
+  // DefinitionalClauses() distributes conjuncts with at most n clauses in CNF
+  // and names the subformulas of larger ones; -1 means it never distributes.
+  void set_max_distributed(const int n) { max_distributed_ = n; }
+  int max_distributed() const { return max_distributed_; }
+
+  // Grounds f, whose quantifiers range over sort_names(sort), clause by clause
+  // and passes every clause as std::vector<Lit> to sink, such as
+  // LimSat::AddClause() or Sat::AddClause(). The formula f needs to be closed
+  // and normalized so that, when its quantifiers are read as con- and
+  // disjunctions, it is a conjunction of disjunctions of literals. Literals
+  // are stripped on the fly, and valid clauses are skipped. Returns false
+  // without passing any clause if f is not of that shape.
+  template<typename UnaryFunction, typename ClauseSink>
+  static bool StreamClauses(const RFormula& f, UnaryFunction sort_names, ClauseSink sink) {
+    std::vector<Abc::VarSymbol> bound;
+    if (!Clausal(f, false, &bound)) {
+      return false;
+    }
+    Abc::DenseMap<Abc::VarSymbol, class Name> map;
+    std::vector<Lit> clause;
+    StreamConjunction(&sort_names, &map, f, &clause, &sink);
+    return true;
+  }
+
+ private:
+  static constexpr int  kHeaderSize  = 3;
+  static constexpr char kConjunctive = 1;
+  static constexpr char kDisjunctive = 2;
+  static constexpr char kPositive    = 1;
+  static constexpr char kNegative    = 2;
+
+  // first is the beginning of the formula that is grounded, free_vars holds
+  // the free variables of the subformula or term at every offset, and map
+  // is the current binding.
+  struct Context {
+    explicit Context(const RFormula& f) : first(f.begin()), free_vars(std::distance(f.begin(), f.end())) {}
+    Abc::Symbol::CRef                          first;
+    std::vector<std::vector<Abc::VarSymbol>>   free_vars;
+    Abc::DenseMap<Abc::VarSymbol, class Name>  map{};
+  };
+
+  static void Encode(const Abc::Symbol& s, std::vector<int>* key) {
+    int a = 0;
+    int b = 0;
+    switch (s.tag) {
+      case Abc::Symbol::kFun:          a = s.u.f.id(); break;
+      case Abc::Symbol::kName:         a = s.u.n.id(); break;
+      case Abc::Symbol::kVar:
+      case Abc::Symbol::kExists:
+      case Abc::Symbol::kForall:       a = s.u.x.id(); break;
+      case Abc::Symbol::kStrippedFun:  a = int(s.u.f_s.id()); break;
+      case Abc::Symbol::kStrippedName: a = int(s.u.n_s.id()); break;
+      case Abc::Symbol::kStrippedLit:  a = int(internal::u64(s.u.a.id()) >> 32); b = int(internal::u32(s.u.a.id())); break;
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kAnd:
+      case Abc::Symbol::kKnow:
+      case Abc::Symbol::kMaybe:        a = s.u.k; break;
+      case Abc::Symbol::kBelieve:      a = s.u.kl.k; b = s.u.kl.l; break;
+      case Abc::Symbol::kEquals:
+      case Abc::Symbol::kNotEquals:
+      case Abc::Symbol::kNot:
+      case Abc::Symbol::kAction:       break;
+    }
+    key->push_back(s.tag);
+    key->push_back(a);
+    key->push_back(b);
+  }
+
+  node_t Intern(const Abc::Symbol& s, const std::vector<node_t>& args) {
+    key_.clear();
+    Encode(s, &key_);
+    key_.insert(key_.end(), args.begin(), args.end());
+    const std::pair<node_t, bool> p = nodes_.Insert(key_);
+    if (p.second) {
+      heads_.push_back(s);
+    }
+    return p.first;
+  }
+
+  node_t Intern(const RFormula& f) {
+    std::vector<node_t> args;
+    args.reserve(f.arity());
+    for (const RFormula& g : f.args()) {
+      args.push_back(Intern(g));
+    }
+    return Intern(f.head(), args);
+  }
+
+  // Replaces the ground but unstripped literal or term v with its stripped
+  // version.
+  node_t Strip(const node_t v) {
+    Formula f = Expand(v);
+    if (!f.readable().ground() || f.readable().stripped()) {
+      return v;
+    }
+    f.Strip();
+    return Intern(f.readable());
+  }
+
+  void InitFreeVars(Context* ctx, const RFormula& f) {
+    const Abc::Symbol s = f.head();
+    std::vector<Abc::VarSymbol>& xs = ctx->free_vars[std::distance(ctx->first, f.begin())];
+    if (s.tag == Abc::Symbol::kVar) {
+      xs.push_back(s.u.x);
+      return;
+    }
+    for (const RFormula& g : f.args()) {
+      InitFreeVars(ctx, g);
+      const std::vector<Abc::VarSymbol>& ys = ctx->free_vars[std::distance(ctx->first, g.begin())];
+      xs.insert(xs.end(), ys.begin(), ys.end());
+    }
+    if (s.quantifier()) {
+      xs.erase(std::remove(xs.begin(), xs.end(), s.u.x), xs.end());
+    }
+    std::sort(xs.begin(), xs.end(), [](Abc::VarSymbol x, Abc::VarSymbol y) { return x.id() < y.id(); });
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  }
+
+  // Subformulas are memoized by their offset and the binding of their free
+  // variables; terms are cheap enough to be interned again.
+  template<typename UnaryFunction>
+  node_t GroundNode(UnaryFunction* sort_names, Context* ctx, const RFormula& f) {
+    const Abc::Symbol s = f.head();
+    const int offset = std::distance(ctx->first, f.begin());
+    int memo = -1;
+    if (!s.term()) {
+      key_.clear();
+      key_.push_back(offset);
+      for (const Abc::VarSymbol x : ctx->free_vars[offset]) {
+        key_.push_back(ctx->map[x].id());
+      }
+      const std::pair<int, bool> p = memo_keys_.Insert(key_);
+      if (!p.second) {
+        return memo_nodes_[p.first];
+      }
+      memo = p.first;
+    }
+    std::vector<node_t> args;
+    node_t v;
+    if (s.tag == Abc::Symbol::kVar) {
+      const class Name n = ctx->map[s.u.x];
+      v = Intern(!n.null() ? Abc::Symbol::StrippedName(n) : s, args);
+    } else if (s.quantifier()) {
+      const Abc::VarSymbol x = s.u.x;
+      const class Name old = ctx->map[x];
+      for (const class Name n : (*sort_names)(x.sort())) {
+        ctx->map[x] = n;
+        args.push_back(GroundNode(sort_names, ctx, f.arg(0)));
+      }
+      ctx->map[x] = old;
+      const int k = args.size();
+      v = Intern(s.tag == Abc::Symbol::kExists ? Abc::Symbol::Or(k) : Abc::Symbol::And(k), args);
+    } else {
+      args.reserve(f.arity());
+      for (const RFormula& g : f.args()) {
+        args.push_back(GroundNode(sort_names, ctx, g));
+      }
+      if (s.tag == Abc::Symbol::kAction) {
+        args[0] = Strip(args[0]);
+      }
+      v = Intern(s, args);
+      if (s.tag == Abc::Symbol::kEquals || s.tag == Abc::Symbol::kNotEquals) {
+        v = Strip(v);
+      }
+    }
+    if (memo >= 0) {
+      if (memo >= int(memo_nodes_.size())) {
+        memo_nodes_.resize(memo + 1);
+      }
+      memo_nodes_[memo] = v;
+    }
+    return v;
+  }
+
+  void AppendExpanded(const node_t v, Abc::Symbol::List* symbols) const {
+    symbols->push_back(heads_[v]);
+    for (const node_t w : args(v)) {
+      AppendExpanded(w, symbols);
+    }
+  }
+
+  bool CheckConjunction(const node_t v, std::vector<char>* seen) const {
+    if ((*seen)[v] & kConjunctive) {
+      return true;
+    }
+    (*seen)[v] |= kConjunctive;
+    switch (heads_[v].tag) {
+      case Abc::Symbol::kAnd:
+        for (const node_t w : args(v)) {
+          if (!CheckConjunction(w, seen)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kOr:
+        return CheckDisjunction(v, seen);
+      case Abc::Symbol::kStrippedLit:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool CheckDisjunction(const node_t v, std::vector<char>* seen) const {
+    if ((*seen)[v] & kDisjunctive) {
+      return true;
+    }
+    (*seen)[v] |= kDisjunctive;
+    switch (heads_[v].tag) {
+      case Abc::Symbol::kOr:
+        for (const node_t w : args(v)) {
+          if (!CheckDisjunction(w, seen)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kAnd:
+        return heads_[v].arity() == 0;
+      case Abc::Symbol::kStrippedLit:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  template<typename ClauseSink>
+  void EmitConjunction(const node_t v, std::vector<char>* seen, std::vector<Lit>* clause, ClauseSink* sink) const {
+    if ((*seen)[v]) {
+      return;
+    }
+    (*seen)[v] = kConjunctive;
+    switch (heads_[v].tag) {
+      case Abc::Symbol::kAnd:
+        for (const node_t w : args(v)) {
+          EmitConjunction(w, seen, clause, sink);
+        }
+        break;
+      case Abc::Symbol::kOr:
+        clause->clear();
+        if (CollectDisjunction(v, clause)) {
+          (*sink)(*clause);
+        }
+        break;
+      case Abc::Symbol::kStrippedLit:
+        clause->clear();
+        clause->push_back(heads_[v].u.a);
+        (*sink)(*clause);
+        break;
+      default:
+        assert(false);
+        break;
+    }
+  }
+
+  // Returns false if the disjunction is valid.
+  bool CollectDisjunction(const node_t v, std::vector<Lit>* clause) const {
+    switch (heads_[v].tag) {
+      case Abc::Symbol::kOr:
+        for (const node_t w : args(v)) {
+          if (!CollectDisjunction(w, clause)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kStrippedLit:
+        clause->push_back(heads_[v].u.a);
+        return true;
+      default:
+        assert(heads_[v].tag == Abc::Symbol::kAnd && heads_[v].arity() == 0);
+        return false;
+    }
+  }
+
+  static bool Clausal(const RFormula& f, const bool disjunctive, std::vector<Abc::VarSymbol>* bound) {
+    const Abc::Symbol s = f.head();
+    switch (s.tag) {
+      case Abc::Symbol::kAnd:
+      case Abc::Symbol::kOr:
+        if (s.tag == Abc::Symbol::kAnd && disjunctive && s.arity() > 1) {
+          return false;
+        }
+        for (const RFormula& g : f.args()) {
+          if (!Clausal(g, disjunctive || s.tag == Abc::Symbol::kOr, bound)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kExists:
+      case Abc::Symbol::kForall: {
+        if (s.tag == Abc::Symbol::kForall && disjunctive) {
+          return false;
+        }
+        bound->push_back(s.u.x);
+        const bool r = Clausal(f.arg(0), disjunctive || s.tag == Abc::Symbol::kExists, bound);
+        bound->pop_back();
+        return r;
+      }
+      case Abc::Symbol::kEquals:
+      case Abc::Symbol::kNotEquals:
+        for (const Abc::Symbol& t : f.rword()) {
+          if (t.tag == Abc::Symbol::kVar && std::find(bound->begin(), bound->end(), t.u.x) == bound->end()) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kStrippedLit:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  template<typename UnaryFunction, typename ClauseSink>
+  static void StreamConjunction(UnaryFunction* sort_names,
+                                Abc::DenseMap<Abc::VarSymbol, class Name>* map,
+                                const RFormula& f,
+                                std::vector<Lit>* clause,
+                                ClauseSink* sink) {
+    const Abc::Symbol s = f.head();
+    if (s.tag == Abc::Symbol::kAnd) {
+      for (const RFormula& g : f.args()) {
+        StreamConjunction(sort_names, map, g, clause, sink);
+      }
+    } else if (s.tag == Abc::Symbol::kForall) {
+      const Abc::VarSymbol x = s.u.x;
+      const class Name old = (*map)[x];
+      for (const class Name n : (*sort_names)(x.sort())) {
+        (*map)[x] = n;
+        StreamConjunction(sort_names, map, f.arg(0), clause, sink);
+      }
+      (*map)[x] = old;
+    } else {
+      clause->clear();
+      if (StreamDisjunction(sort_names, map, f, clause)) {
+        (*sink)(*clause);
+      }
+    }
+  }
+
+  // Returns false if the disjunction is valid.
+  template<typename UnaryFunction>
+  static bool StreamDisjunction(UnaryFunction* sort_names,
+                                Abc::DenseMap<Abc::VarSymbol, class Name>* map,
+                                const RFormula& f,
+                                std::vector<Lit>* clause) {
+    const Abc::Symbol s = f.head();
+    switch (s.tag) {
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kAnd:
+        if (s.tag == Abc::Symbol::kAnd && s.arity() == 0) {
+          return false;
+        }
+        for (const RFormula& g : f.args()) {
+          if (!StreamDisjunction(sort_names, map, g, clause)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kExists: {
+        const Abc::VarSymbol x = s.u.x;
+        const class Name old = (*map)[x];
+        bool r = true;
+        for (const class Name n : (*sort_names)(x.sort())) {
+          (*map)[x] = n;
+          if (!(r = StreamDisjunction(sort_names, map, f.arg(0), clause))) {
+            break;
+          }
+        }
+        (*map)[x] = old;
+        return r;
+      }
+      case Abc::Symbol::kStrippedLit:
+        clause->push_back(s.u.a);
+        return true;
+      default: {
+        assert(s.tag == Abc::Symbol::kEquals || s.tag == Abc::Symbol::kNotEquals);
+        Abc::Symbol::List symbols;
+        symbols.reserve(std::distance(f.begin(), f.end()));
+        for (const Abc::Symbol& t : f.rword()) {
+          symbols.push_back(t.tag == Abc::Symbol::kVar ? Abc::Symbol::StrippedName((*map)[t.u.x]) : t);
+        }
+        Formula lit{Abc::Word(std::move(symbols))};
+        lit.Strip();
+        if (lit.tag() == Abc::Symbol::kStrippedLit) {
+          clause->push_back(lit.head().u.a);
+          return true;
+        }
+        assert(lit.arity() == 0);
+        return lit.tag() == Abc::Symbol::kOr;
+      }
+    }
+  }
+
+  bool CheckPropositional(const node_t v, std::vector<char>* seen) const {
+    if ((*seen)[v]) {
+      return true;
+    }
+    (*seen)[v] = 1;
+    switch (heads_[v].tag) {
+      case Abc::Symbol::kAnd:
+      case Abc::Symbol::kOr:
+      case Abc::Symbol::kNot:
+        for (const node_t w : args(v)) {
+          if (!CheckPropositional(w, seen)) {
+            return false;
+          }
+        }
+        return true;
+      case Abc::Symbol::kStrippedLit:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  Lit Aux(const node_t v) {
+    if (aux_[v].null()) {
+      if (aux_sort_.null()) {
+        aux_sort_ = Abc::instance().CreateSort(false);
+        Formula t = Formula::Name(Abc::instance().CreateName(aux_sort_, 0));
+        t.Strip();
+        aux_true_ = t.head().u.n_s;
+      }
+      Formula p = Formula::Fun(Abc::instance().CreateFun(aux_sort_, 0));
+      p.Strip();
+      aux_[v] = Lit::Eq(p.head().u.f_s, aux_true_);
+    }
+    return aux_[v];
+  }
+
+  template<typename ClauseSink>
+  void DefineConjunction(const node_t v, std::vector<char>* seen, std::vector<Lit>* clause, ClauseSink* sink) {
+    if ((*seen)[v]) {
+      return;
+    }
+    (*seen)[v] = 1;
+    if (heads_[v].tag == Abc::Symbol::kAnd) {
+      for (const node_t w : args(v)) {
+        DefineConjunction(w, seen, clause, sink);
+      }
+    } else if (CnfSize(v, true) <= max_distributed_) {
+      std::vector<std::vector<Lit>> cs;
+      Distribute(v, true, &cs);
+      for (const std::vector<Lit>& c : cs) {
+        (*sink)(c);
+      }
+    } else {
+      clause->clear();
+      if (DefineDisjunction(v, clause, sink)) {
+        (*sink)(*clause);
+      }
+    }
+  }
+
+  // Returns false if the disjunction is valid.
+  template<typename ClauseSink>
+  bool DefineDisjunction(const node_t v, std::vector<Lit>* clause, ClauseSink* sink) {
+    const Abc::Symbol& s = heads_[v];
+    if (s.tag == Abc::Symbol::kOr) {
+      for (const node_t w : args(v)) {
+        if (!DefineDisjunction(w, clause, sink)) {
+          return false;
+        }
+      }
+      return true;
+    } else if (s.tag == Abc::Symbol::kAnd && s.arity() == 0) {
+      return false;
+    } else {
+      clause->push_back(Define(v, true, sink));
+      return true;
+    }
+  }
+
+  // Returns the number of clauses of the CNF of v if pos is true and of ~v
+  // otherwise, or max_distributed_ + 1 if there are more.
+  int CnfSize(const node_t v, const bool pos) {
+    int& n = cnf_sizes_[2 * v + pos];
+    if (n >= 0) {
+      return n;
+    }
+    const Abc::Symbol& s = heads_[v];
+    const internal::i64 limit = internal::i64(max_distributed_) + 1;
+    if (s.tag == Abc::Symbol::kStrippedLit) {
+      n = 1;
+    } else if (s.tag == Abc::Symbol::kNot) {
+      n = CnfSize(args(v)[0], !pos);
+    } else if ((s.tag == Abc::Symbol::kAnd) == pos) {
+      internal::i64 sum = 0;
+      for (const node_t w : args(v)) {
+        sum = std::min(sum + CnfSize(w, pos), limit);
+      }
+      n = int(sum);
+    } else {
+      internal::i64 product = 1;
+      for (const node_t w : args(v)) {
+        if (product < limit) {
+          product = std::min(product * CnfSize(w, pos), limit);
+        }
+      }
+      n = int(product);
+    }
+    return n;
+  }
+
+  // Appends the clauses of the CNF of v if pos is true and of ~v otherwise to
+  // cs.
+  void Distribute(const node_t v, const bool pos, std::vector<std::vector<Lit>>* cs) const {
+    const Abc::Symbol& s = heads_[v];
+    if (s.tag == Abc::Symbol::kStrippedLit) {
+      cs->push_back(std::vector<Lit>{pos ? s.u.a : s.u.a.flip()});
+    } else if (s.tag == Abc::Symbol::kNot) {
+      Distribute(args(v)[0], !pos, cs);
+    } else if ((s.tag == Abc::Symbol::kAnd) == pos) {
+      for (const node_t w : args(v)) {
+        Distribute(w, pos, cs);
+      }
+    } else {
+      std::vector<std::vector<Lit>> product(1);
+      for (const node_t w : args(v)) {
+        if (product.empty()) {
+          break;
+        }
+        std::vector<std::vector<Lit>> ds;
+        Distribute(w, pos, &ds);
+        std::vector<std::vector<Lit>> next;
+        next.reserve(product.size() * ds.size());
+        for (const std::vector<Lit>& c : product) {
+          for (const std::vector<Lit>& d : ds) {
+            next.push_back(c);
+            for (const Lit a : d) {
+              if (std::find(c.begin(), c.end(), a) == c.end()) {
+                next.back().push_back(a);
+              }
+            }
+          }
+        }
+        product = std::move(next);
+      }
+      cs->insert(cs->end(), product.begin(), product.end());
+    }
+  }
+
+  // Returns a literal that implies v if pos is true and is implied by v
+  // otherwise.
+  template<typename ClauseSink>
+  Lit Define(const node_t v, const bool pos, ClauseSink* sink) {
+    const Abc::Symbol& s = heads_[v];
+    if (s.tag == Abc::Symbol::kStrippedLit) {
+      return s.u.a;
+    } else if (s.tag == Abc::Symbol::kNot) {
+      return Define(args(v)[0], !pos, sink).flip();
+    }
+    assert(s.tag == Abc::Symbol::kAnd || s.tag == Abc::Symbol::kOr);
+    const Lit a = Aux(v);
+    const char polarity = pos ? kPositive : kNegative;
+    if (defined_[v] & polarity) {
+      return a;
+    }
+    defined_[v] |= polarity;
+    if ((s.tag == Abc::Symbol::kAnd) == pos) {
+      // a -> w_1 ^ ... ^ w_k or w_1 v ... v w_k -> a
+      for (const node_t w : args(v)) {
+        std::vector<Lit> c;
+        c.push_back(pos ? a.flip() : a);
+        c.push_back(pos ? Define(w, pos, sink) : Define(w, pos, sink).flip());
+        (*sink)(c);
+      }
+    } else {
+      // a -> w_1 v ... v w_k or w_1 ^ ... ^ w_k -> a
+      std::vector<Lit> c;
+      c.push_back(pos ? a.flip() : a);
+      for (const node_t w : args(v)) {
+        c.push_back(pos ? Define(w, pos, sink) : Define(w, pos, sink).flip());
+      }
+      (*sink)(c);
+    }
+    return a;
+  }
+
+  // nodes_ holds for every node the encoded head symbol followed by the ids
+  //    of the argument nodes; heads_ holds the head symbol itself.
+  // memo_keys_ and memo_nodes_ map a subformula's offset and the binding of
+  //    its free variables to the node it was grounded to.
+  internal::ArenaSet<int>  nodes_{};
+  std::vector<Abc::Symbol> heads_{};
+  internal::ArenaSet<int>  memo_keys_{};
+  std::vector<node_t>      memo_nodes_{};
+  std::vector<int>         key_{};
+
+  // max_distributed_ bounds the CNF size of conjuncts that are distributed,
+  //    and cnf_sizes_ caches CnfSize() for both polarities of every node.
+  // aux_ holds the auxiliary literal of every node or null, and defined_
+  //    whether its positive and/or negative definition has been passed on.
+  // aux_sort_ is the sort of the auxiliary functions, and aux_true_ is the
+  //    name T they are compared to.
+  int                      max_distributed_ = 16;
+  std::vector<int>         cnf_sizes_{};
+  std::vector<Lit>         aux_{};
+  std::vector<char>        defined_{};
+  Abc::Sort                aux_sort_{};
+  class Name               aux_true_{};
+};
+
+}  // namespace limbo
+
+#endif  // LIMBO_GROUNDER_H_
+
@@ -0,0 +1,200 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// ArenaSet is a set of sequences, which are stored back to back in a single
+// arena and are identified by stable integer ids in the order of insertion.
+// Duplicates are detected by a 64-bit fingerprint in an open-addressing hash
+// index. Ranges obtained from the set are invalidated by Insert().
+
+#ifndef LIMBO_INTERNAL_ARENA_H_
+#define LIMBO_INTERNAL_ARENA_H_
+
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <limbo/internal/hash.h>
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+template<typename T>
+class ArenaSet {
+ public:
+  using id_t = int;
+
+  class Range {
+   public:
+    using value_type     = T;
+    using const_iterator = const T*;
+
+    Range(const T* begin, const T* end) : begin_(begin), end_(end) {}
+
+    const T* begin() const { return begin_; }
+    const T* end()   const { return end_; }
+
+    int  size()  const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+
+    const T& operator[](const int i) const { assert(0 <= i && i < size()); return begin_[i]; }
+
+   private:
+    const T* begin_;
+    const T* end_;
+  };
+
+  class const_iterator {
+   public:
+    using difference_type   = id_t;
+    using value_type        = Range;
+    using pointer           = const Range*;
+    using reference         = Range;
+    using iterator_category = std::forward_iterator_tag;
+
+    const_iterator(const ArenaSet* set, const id_t id) : set_(set), id_(id) {}
+
+    bool operator==(const const_iterator it) const { return id_ == it.id_; }
+    bool operator!=(const const_iterator it) const { return !(*this == it); }
+
+    Range operator*() const { return (*set_)[id_]; }
+
+    const_iterator& operator++() { ++id_; return *this; }
+
+   private:
+    const ArenaSet* set_;
+    id_t            id_;
+  };
+
+  ArenaSet() = default;
+
+  ArenaSet(const ArenaSet&)            = default;
+  ArenaSet& operator=(const ArenaSet&) = default;
+  ArenaSet(ArenaSet&&)                 = default;
+  ArenaSet& operator=(ArenaSet&&)      = default;
+
+  // Inserts the sequence [first, last) unless it is contained already.
+  // Returns the sequence's id and whether it is new.
+  template<typename InputIt>
+  std::pair<id_t, bool> Insert(InputIt first, InputIt last) {
+    const int offset = elems_.size();
+    elems_.insert(elems_.end(), first, last);
+    const hash64_t h = Fingerprint(elems_.data() + offset, elems_.data() + elems_.size());
+    const int i = Lookup(h, offset);
+    if (index_[i] != kEmpty) {
+      elems_.resize(offset);
+      return std::make_pair(index_[i], false);
+    }
+    const id_t id = size();
+    offsets_.push_back(elems_.size());
+    fingerprints_.push_back(h);
+    if (2 * size() > int(index_.size())) {
+      Rehash(2 * index_.size());
+    } else {
+      index_[i] = id;
+    }
+    return std::make_pair(id, true);
+  }
+
+  std::pair<id_t, bool> Insert(const std::vector<T>& xs) { return Insert(xs.begin(), xs.end()); }
+
+  // Returns the id of the sequence [first, last) or -1 if it is not contained.
+  template<typename InputIt>
+  id_t Find(InputIt first, InputIt last) const {
+    const std::vector<T> xs(first, last);
+    const hash64_t h = Fingerprint(xs.data(), xs.data() + xs.size());
+    for (int i = h & (index_.size() - 1); index_[i] != kEmpty; i = (i + 1) & (index_.size() - 1)) {
+      const id_t id = index_[i];
+      const Range r = (*this)[id];
+      if (fingerprints_[id] == h && std::equal(r.begin(), r.end(), xs.begin(), xs.end())) {
+        return id;
+      }
+    }
+    return kEmpty;
+  }
+
+  bool contains(const std::vector<T>& xs) const { return Find(xs.begin(), xs.end()) != kEmpty; }
+
+  int  size()  const { return int(offsets_.size()) - 1; }
+  bool empty() const { return size() == 0; }
+
+  Range operator[](const id_t id) const {
+    assert(0 <= id && id < size());
+    return Range(elems_.data() + offsets_[id], elems_.data() + offsets_[id + 1]);
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end()   const { return const_iterator(this, size()); }
+
+  void Clear() {
+    elems_.clear();
+    offsets_.assign(1, 0);
+    fingerprints_.clear();
+    index_.assign(kInitialIndexSize, kEmpty);
+  }
+
+ private:
+  static constexpr id_t kEmpty            = -1;
+  static constexpr int  kInitialIndexSize = 16;
+
+  static hash64_t Fingerprint(const T* first, const T* last) {
+    hash64_t h = last - first;
+    for (; first != last; ++first) {
+      h = fnv1a_hash(*first, h);
+    }
+    return h;
+  }
+
+  // Returns the index slot that holds the sequence that starts at offset in
+  // elems_ and runs until the end, or the empty slot where it belongs.
+  int Lookup(const hash64_t h, const int offset) const {
+    const int mask = index_.size() - 1;
+    const int size = int(elems_.size()) - offset;
+    int i = h & mask;
+    for (; index_[i] != kEmpty; i = (i + 1) & mask) {
+      const id_t id = index_[i];
+      if (fingerprints_[id] == h && offsets_[id + 1] - offsets_[id] == size &&
+          std::equal(elems_.begin() + offsets_[id], elems_.begin() + offsets_[id + 1], elems_.begin() + offset)) {
+        break;
+      }
+    }
+    return i;
+  }
+
+  void Rehash(const int n) {
+    assert(n == int(next_power_of_two(n)));
+    index_.assign(n, kEmpty);
+    for (id_t id = 0; id < size(); ++id) {
+      int i = fingerprints_[id] & (n - 1);
+      while (index_[i] != kEmpty) {
+        i = (i + 1) & (n - 1);
+      }
+      index_[i] = id;
+    }
+  }
+
+  // elems_ holds the sequences back to back, where the sequence with id i
+  //    ranges from offsets_[i] to offsets_[i+1].
+  // fingerprints_ holds the hash value of every sequence.
+  // index_ is an open-addressing hash table with linear probing whose slots
+  //    are ids or kEmpty; its size is a power of two.
+  std::vector<T>        elems_{};
+  std::vector<int>      offsets_      = std::vector<int>(1, 0);
+  std::vector<hash64_t> fingerprints_{};
+  std::vector<id_t>     index_        = std::vector<id_t>(kInitialIndexSize, kEmpty);
+};
+
+template<typename T>
+constexpr typename ArenaSet<T>::id_t ArenaSet<T>::kEmpty;
+
+template<typename T>
+constexpr int ArenaSet<T>::kInitialIndexSize;
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_ARENA_H_
+
@@ -2,15 +2,19 @@
 // Copyright 2016-2019 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// DenseMap, DenseMinHeap classes, which are based on representing keys or
-// entries, respectively, as non-negative integers close to zero.
+// DenseMap, DenseMatrix, DenseMinHeap, DenseDaryMinHeap classes, which are
+// based on representing keys or entries, respectively, as non-negative
+// integers close to zero.
 
 #ifndef LIMBO_INTERNAL_DENSE_H_
 #define LIMBO_INTERNAL_DENSE_H_
 
 #include <algorithm>
+#include <utility>
 #include <vector>
 
+#include <limbo/internal/ints.h>
+
 namespace limbo {
 namespace internal {
 
@@ -238,8 +242,8 @@ class DenseMinHeap {
  private:
   using Map = DenseMap<T, Index, Index, kOffset, KeyToIndex, IndexToKey, CheckBound>;
 
-  static Index left(const Index i)   { return 2 * i; }
-  static Index right(const Index i)  { return 2 * i + 1; }
+  static size_t left(const Index i)  { return 2 * size_t(i); }
+  static size_t right(const Index i) { return 2 * size_t(i) + 1; }
   static Index parent(const Index i) { return i / 2; }
 
   void SiftUp(Index i) {
@@ -259,10 +263,10 @@ class DenseMinHeap {
   void SiftDown(Index i) {
     assert(i > 0 && i < heap_.size());
     const T x = heap_[i];
-    while (left(i) < Index(heap_.size())) {
-      const Index min_child =
-          right(i) < Index(heap_.size()) && less_(heap_[right(i)], heap_[left(i)])
-          ? right(i) : left(i);
+    while (left(i) < heap_.size()) {
+      const Index min_child = Index(
+          right(i) < heap_.size() && less_(heap_[right(i)], heap_[left(i)])
+          ? right(i) : left(i));
       if (!less_(heap_[min_child], x)) {
         break;
       }
@@ -280,6 +284,354 @@ class DenseMinHeap {
   Map index_{};
 };
 
+// Cell storage for DenseMatrix: a plain vector, except for bool, which is
+// packed into 64-bit words. kAlign is the granularity of the row stride, so
+// that rows of bools start at word boundaries.
+template<typename Val>
+class DenseCells {
+ public:
+  using reference       = typename std::vector<Val>::reference;
+  using const_reference = typename std::vector<Val>::const_reference;
+  using const_iterator  = typename std::vector<Val>::const_iterator;
+
+  static constexpr size_t kAlign = 1;
+
+  void Resize(const size_t n) { vec_.resize(n); }
+
+        reference operator[](const size_t i)       { return vec_[i]; }
+  const_reference operator[](const size_t i) const { return vec_[i]; }
+
+  const_iterator begin() const { return vec_.begin(); }
+  const_iterator end()   const { return vec_.end(); }
+
+ private:
+  std::vector<Val> vec_{};
+};
+
+template<>
+class DenseCells<bool> {
+ public:
+  class reference {
+   public:
+    explicit reference(u64* w, const u64 mask) : w_(w), mask_(mask) {}
+    operator bool() const { return *w_ & mask_; }
+    reference& operator=(const bool b) { *w_ = b ? (*w_ | mask_) : (*w_ & ~mask_); return *this; }
+    reference& operator=(const reference& r) { return *this = bool(r); }
+   private:
+    u64* w_;
+    u64 mask_;
+  };
+  using const_reference = bool;
+
+  static constexpr size_t kAlign = 64;
+
+  void Resize(const size_t n) { words_.resize((n + 63) / 64); }
+
+  reference       operator[](const size_t i)       { return reference(&words_[i / 64], u64(1) << (i % 64)); }
+  const_reference operator[](const size_t i) const { return (words_[i / 64] >> (i % 64)) & 1; }
+
+  // Precondition: first is a multiple of kAlign.
+  bool any(const size_t first, const size_t last) const {
+    return std::any_of(words_.begin() + first / 64, words_.begin() + (last + 63) / 64, [](u64 w) { return w != 0; });
+  }
+
+ private:
+  std::vector<u64> words_{};
+};
+
+// A two-dimensional DenseMap, stored row by row in one contiguous block.
+// Rows and columns grow independently; the row stride grows by half when
+// columns are added beyond it. The rows are accessed through views that
+// behave like DenseMaps of the columns; FitForKey() on a view grows the
+// columns of all rows. The outer functions FitForKey(), keys() etc. refer to
+// the rows.
+template<typename RowKey,
+         typename ColKey,
+         typename Val,
+         typename Index,
+         Index kOffset,
+         typename RowKeyToIndex,
+         typename IndexToRowKey,
+         typename ColKeyToIndex,
+         typename IndexToColKey>
+class DenseMatrix {
+ public:
+  using Cells           = DenseCells<Val>;
+  using reference       = typename Cells::reference;
+  using const_reference = typename Cells::const_reference;
+
+  using RowMap = DenseMap<RowKey, bool, Index, kOffset, RowKeyToIndex, IndexToRowKey, NoBoundCheck>;
+  using ColMap = DenseMap<ColKey, bool, Index, kOffset, ColKeyToIndex, IndexToColKey, NoBoundCheck>;
+
+  template<typename Matrix>
+  class RowView {
+   public:
+    explicit RowView(Matrix* m, const Index i) : m_(m), i_(i) {}
+
+    void FitForKey(ColKey k)  const { m_->FitForColIndex(m_->c2i_(k)); }
+    void FitForIndex(Index j) const { m_->FitForColIndex(j); }
+
+    bool empty() const { return m_->cols_ == 0; }
+
+    bool key_in_range(ColKey k)     const { return index_in_range(m_->c2i_(k)); }
+    bool index_in_range(Index j)    const { j -= kOffset; return 0 <= j && j < m_->cols_; }
+
+    Index  upper_bound_index() const { return m_->cols_ - 1 + kOffset; }
+    ColKey upper_bound_key()   const { return m_->i2c_(upper_bound_index()); }
+
+    decltype(auto) at_index(Index j)     const { return m_->at_index(i_, j); }
+    decltype(auto) at_key(ColKey k)      const { return at_index(m_->c2i_(k)); }
+    decltype(auto) operator[](ColKey k)  const { return at_key(k); }
+
+    typename ColMap::template Range<typename ColMap::KeyIterator> keys() const {
+      using KeyIterator = typename ColMap::KeyIterator;
+      return typename ColMap::template Range<KeyIterator>(KeyIterator(kOffset, m_->c2i_, m_->i2c_),
+                                                          KeyIterator(m_->cols_ + kOffset, m_->c2i_, m_->i2c_));
+    }
+
+    // Only for bool: true iff some cell of the row is true.
+    bool any() const { return m_->cells_.any((i_ - kOffset) * m_->stride_, (i_ - kOffset) * m_->stride_ + m_->cols_); }
+
+   private:
+    Matrix* m_;
+    Index i_;
+  };
+
+  using Row      = RowView<DenseMatrix>;
+  using ConstRow = RowView<const DenseMatrix>;
+
+  explicit DenseMatrix(RowKeyToIndex r2i = RowKeyToIndex(), IndexToRowKey i2r = IndexToRowKey(),
+                       ColKeyToIndex c2i = ColKeyToIndex(), IndexToColKey i2c = IndexToColKey())
+      : r2i_(r2i), i2r_(i2r), c2i_(c2i), i2c_(i2c) {}
+
+  DenseMatrix(const DenseMatrix&)            = default;
+  DenseMatrix& operator=(const DenseMatrix&) = default;
+  DenseMatrix(DenseMatrix&&)                 = default;
+  DenseMatrix& operator=(DenseMatrix&&)      = default;
+
+  void FitForKey(RowKey k)  { FitForIndex(r2i_(k)); }
+  void FitForIndex(Index i) { i -= kOffset; if (i >= rows_) { rows_ = i + 1; cells_.Resize(rows_ * stride_); } }
+
+  void FitForColKey(ColKey k) { FitForColIndex(c2i_(k)); }
+  void FitForColIndex(Index j) {
+    j -= kOffset;
+    if (j >= cols_) {
+      if (j >= stride_) {
+        Restride(std::max(j + 1, stride_ + stride_ / 2));
+      }
+      cols_ = j + 1;
+    }
+  }
+
+  bool empty() const { return rows_ == 0; }
+
+  void Clear() { cells_ = Cells(); rows_ = 0; cols_ = 0; stride_ = 0; }
+
+  bool key_in_range(RowKey k)  const { return index_in_range(r2i_(k)); }
+  bool index_in_range(Index i) const { i -= kOffset; return 0 <= i && i < rows_; }
+
+  Index  upper_bound_index() const { return rows_ - 1 + kOffset; }
+  RowKey upper_bound_key()   const { return i2r_(upper_bound_index()); }
+
+  Index  upper_bound_col_index() const { return cols_ - 1 + kOffset; }
+  ColKey upper_bound_col_key()   const { return i2c_(upper_bound_col_index()); }
+
+        reference at_index(Index i, Index j)       { return cells_[(i - kOffset) * stride_ + (j - kOffset)]; }
+  const_reference at_index(Index i, Index j) const { return cells_[(i - kOffset) * stride_ + (j - kOffset)]; }
+
+  Row      operator[](RowKey k)       { return Row(this, r2i_(k)); }
+  ConstRow operator[](RowKey k) const { return ConstRow(this, r2i_(k)); }
+
+  typename RowMap::template Range<typename RowMap::KeyIterator> keys() const {
+    using KeyIterator = typename RowMap::KeyIterator;
+    return typename RowMap::template Range<KeyIterator>(KeyIterator(kOffset, r2i_, i2r_),
+                                                        KeyIterator(rows_ + kOffset, r2i_, i2r_));
+  }
+
+  // All cells, including those in the padding of each row, which hold
+  // default values; not available for bool.
+  auto values() const {
+    return typename RowMap::template Range<typename Cells::const_iterator>(cells_.begin(), cells_.end());
+  }
+
+ private:
+  void Restride(Index stride) {
+    stride = (stride + Cells::kAlign - 1) / Cells::kAlign * Cells::kAlign;
+    Cells cells;
+    cells.Resize(rows_ * stride);
+    for (Index i = 0; i < rows_; ++i) {
+      for (Index j = 0; j < cols_; ++j) {
+        cells[i * stride + j] = std::move(cells_[i * stride_ + j]);
+      }
+    }
+    cells_ = std::move(cells);
+    stride_ = stride;
+  }
+
+  RowKeyToIndex r2i_{};
+  IndexToRowKey i2r_{};
+  ColKeyToIndex c2i_{};
+  IndexToColKey i2c_{};
+  Cells cells_{};
+  Index rows_   = 0;
+  Index cols_   = 0;
+  Index stride_ = 0;
+};
+
+// A kArity-ary min-heap whose entries are (key, priority) pairs. Since the
+// priorities are stored next to the keys, comparisons do not look them up in
+// another map, and Increase() and Decrease() update an entry in place.
+// Increase() is for priorities that rank at least as high as before,
+// Decrease() for those that rank at most as high.
+template<typename T,
+         typename Priority,
+         typename Less,
+         int kArity,
+         typename Index,
+         Index kOffset,
+         typename KeyToIndex,
+         typename IndexToKey,
+         typename CheckBound>
+class DenseDaryMinHeap {
+ public:
+  struct Entry {
+    T        key{};
+    Priority priority{};
+  };
+
+  explicit DenseDaryMinHeap(Less less = Less()) : less_(less) {}
+
+  DenseDaryMinHeap(const DenseDaryMinHeap&)            = default;
+  DenseDaryMinHeap& operator=(const DenseDaryMinHeap&) = default;
+  DenseDaryMinHeap(DenseDaryMinHeap&&)                 = default;
+  DenseDaryMinHeap& operator=(DenseDaryMinHeap&&)      = default;
+
+  void FitForElement(const T x) { index_.FitForKey(x); }
+  void FitForIndex(const Index i) { index_.FitForIndex(i); }
+
+  void Clear() { heap_.clear(); index_.Clear(); }
+
+  int size()  const { return heap_.size(); }
+  bool empty() const { return heap_.empty(); }
+  const Entry& operator[](Index i) const { return heap_[i]; }
+
+  bool contains(const T& x) const { return index_[x] != 0; }
+
+  T top() const { return !empty() ? heap_[0].key : T(); }
+
+  const Priority& priority(const T& x) const { assert(contains(x)); return heap_[index_[x] - 1].priority; }
+
+  void Insert(const T& x, const Priority& p) {
+    assert(!contains(x));
+    heap_.push_back(Entry{x, p});
+    SiftUp(heap_.size() - 1);
+    assert(heap_property());
+  }
+
+  void Increase(const T& x, const Priority& p) {
+    assert(contains(x));
+    const Index i = index_[x] - 1;
+    assert(!less_(heap_[i].priority, p));
+    heap_[i].priority = p;
+    SiftUp(i);
+    assert(heap_property());
+  }
+
+  void Decrease(const T& x, const Priority& p) {
+    assert(contains(x));
+    const Index i = index_[x] - 1;
+    assert(!less_(p, heap_[i].priority));
+    heap_[i].priority = p;
+    SiftDown(i);
+    assert(heap_property());
+  }
+
+  void Remove(const T& x) {
+    assert(contains(x));
+    const Index i = index_[x] - 1;
+    index_[x] = 0;
+    const Entry e = heap_.back();
+    heap_.pop_back();
+    if (i < Index(heap_.size())) {
+      heap_[i] = e;
+      if (i > 0 && less_(e.priority, heap_[parent(i)].priority)) {
+        SiftUp(i);
+      } else {
+        SiftDown(i);
+      }
+    }
+    assert(!contains(x));
+    assert(heap_property());
+  }
+
+  // Applies f to every priority; f must preserve their order.
+  template<typename UnaryFunction>
+  void TransformPriorities(UnaryFunction f) {
+    for (Entry& e : heap_) {
+      f(e.priority);
+    }
+    assert(heap_property());
+  }
+
+  typename std::vector<Entry>::const_iterator begin() const { return heap_.begin(); }
+  typename std::vector<Entry>::const_iterator end()   const { return heap_.end(); }
+
+ private:
+  static_assert(kArity >= 2, "kArity must be at least 2");
+
+  using Map = DenseMap<T, Index, Index, kOffset, KeyToIndex, IndexToKey, CheckBound>;
+
+  static size_t child(const Index i) { return kArity * size_t(i) + 1; }
+  static Index parent(const Index i) { return (i - 1) / kArity; }
+
+  // index_ holds the position plus one, so that 0 means absent.
+  void SiftUp(Index i) {
+    const Entry e = heap_[i];
+    while (i > 0 && less_(e.priority, heap_[parent(i)].priority)) {
+      heap_[i] = heap_[parent(i)];
+      index_[heap_[i].key] = i + 1;
+      i = parent(i);
+    }
+    heap_[i] = e;
+    index_[e.key] = i + 1;
+  }
+
+  void SiftDown(Index i) {
+    const Entry e = heap_[i];
+    const size_t n = heap_.size();
+    for (size_t c; (c = child(i)) < n; ) {
+      const size_t last = std::min(c + kArity, n);
+      size_t min_child = c;
+      for (++c; c < last; ++c) {
+        if (less_(heap_[c].priority, heap_[min_child].priority)) {
+          min_child = c;
+        }
+      }
+      if (!less_(heap_[min_child].priority, e.priority)) {
+        break;
+      }
+      heap_[i] = heap_[min_child];
+      index_[heap_[i].key] = i + 1;
+      i = Index(min_child);
+    }
+    heap_[i] = e;
+    index_[e.key] = i + 1;
+  }
+
+  bool heap_property() const {
+    for (Index i = 1; i < Index(heap_.size()); ++i) {
+      if (less_(heap_[i].priority, heap_[parent(i)].priority) || index_[heap_[i].key] != i + 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Less less_{};
+  std::vector<Entry> heap_{};
+  Map index_{};
+};
+
 }  // namespace internal
 }  // namespace limbo
 
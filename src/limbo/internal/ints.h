@@ -7,7 +7,9 @@
 #ifndef LIMBO_INTERNAL_INTS_H_
 #define LIMBO_INTERNAL_INTS_H_
 
+#ifdef __BMI2__
 #include <x86intrin.h>
+#endif
 #include <cstdint>
 
 namespace limbo {
@@ -22,10 +24,21 @@ using u16 = std::uint16_t;
 using u32 = std::uint32_t;
 using u64 = std::uint64_t;
 using uint = unsigned int;
+using ulong = unsigned long;
 using size_t = std::size_t;
 using uptr_t = std::uintptr_t;
 using iptr_t = std::intptr_t;
 
+// BitInterleaver and BitConcatenator merge two integers into one of twice the
+// width. BitInterleaver puts hi's bits at the odd and lo's bits at the even
+// positions, BitConcatenator puts hi in the upper and lo in the lower half.
+// Both support hi_zero(z) to test whether z's hi part is zero, which, applied
+// to the XOR of two merged integers, tests whether their hi parts are equal.
+//
+// BitInterleaver uses the BMI2 instructions pdep and pext where available and
+// otherwise falls back to shifts and masks. Note that pdep and pext are
+// microcoded and slow on some CPUs (e.g., AMD Zen 1 and 2).
+
 template<typename T, int = sizeof(T)>
 struct BitInterleaver {};
 
@@ -33,18 +46,70 @@ template<typename T>
 struct BitInterleaver<T, sizeof(u16)> {
   static constexpr u32 kHi = 0xAAAAAAAA;
   static constexpr u32 kLo = 0x55555555;
+#ifdef __BMI2__
   static u32 merge(u16 hi, u16 lo) { return _pdep_u32(hi, kHi) | _pdep_u32(lo, kLo); }
   static u16 split_hi(u32 z) { return _pext_u32(z, kHi); }
   static u16 split_lo(u32 z) { return _pext_u32(z, kLo); }
+#else
+  static u32 merge(u16 hi, u16 lo) { return (spread(hi) << 1) | spread(lo); }
+  static u16 split_hi(u32 z) { return compact(z >> 1); }
+  static u16 split_lo(u32 z) { return compact(z); }
+#endif
+  static bool hi_zero(u32 z) { return (z & kHi) == 0; }
+
+ private:
+  static u32 spread(u32 z) {
+    z = (z | (z << 8)) & 0x00FF00FF;
+    z = (z | (z << 4)) & 0x0F0F0F0F;
+    z = (z | (z << 2)) & 0x33333333;
+    z = (z | (z << 1)) & 0x55555555;
+    return z;
+  }
+
+  static u16 compact(u32 z) {
+    z &= 0x55555555;
+    z = (z | (z >> 1)) & 0x33333333;
+    z = (z | (z >> 2)) & 0x0F0F0F0F;
+    z = (z | (z >> 4)) & 0x00FF00FF;
+    z = (z | (z >> 8)) & 0x0000FFFF;
+    return u16(z);
+  }
 };
 
 template<typename T>
 struct BitInterleaver<T, sizeof(u32)> {
   static constexpr u64 kHi = 0xAAAAAAAAAAAAAAAA;
   static constexpr u64 kLo = 0x5555555555555555;
+#ifdef __BMI2__
   static u64 merge(u32 hi, u32 lo) { return _pdep_u64(hi, kHi) | _pdep_u64(lo, kLo); }
   static u32 split_hi(u64 z) { return _pext_u64(z, kHi); }
   static u32 split_lo(u64 z) { return _pext_u64(z, kLo); }
+#else
+  static u64 merge(u32 hi, u32 lo) { return (spread(hi) << 1) | spread(lo); }
+  static u32 split_hi(u64 z) { return compact(z >> 1); }
+  static u32 split_lo(u64 z) { return compact(z); }
+#endif
+  static bool hi_zero(u64 z) { return (z & kHi) == 0; }
+
+ private:
+  static u64 spread(u64 z) {
+    z = (z | (z << 16)) & 0x0000FFFF0000FFFF;
+    z = (z | (z <<  8)) & 0x00FF00FF00FF00FF;
+    z = (z | (z <<  4)) & 0x0F0F0F0F0F0F0F0F;
+    z = (z | (z <<  2)) & 0x3333333333333333;
+    z = (z | (z <<  1)) & 0x5555555555555555;
+    return z;
+  }
+
+  static u32 compact(u64 z) {
+    z &= 0x5555555555555555;
+    z = (z | (z >>  1)) & 0x3333333333333333;
+    z = (z | (z >>  2)) & 0x0F0F0F0F0F0F0F0F;
+    z = (z | (z >>  4)) & 0x00FF00FF00FF00FF;
+    z = (z | (z >>  8)) & 0x0000FFFF0000FFFF;
+    z = (z | (z >> 16)) & 0x00000000FFFFFFFF;
+    return u32(z);
+  }
 };
 
 template<typename T, int = sizeof(T)>
@@ -52,11 +117,12 @@ struct BitConcatenator {};
 
 template<typename T>
 struct BitConcatenator<T, sizeof(u16)> {
-  static constexpr u32 kLo = ~u16(0);
+  static constexpr u32 kLo = u16(~u16(0));
   static constexpr u32 kHi = ~kLo;
   static u32 merge(u16 hi, u16 lo) { return (u32(hi) << 16) | u32(lo); }
   static u16 split_hi(u32 z) { return u16(z >> 16); }
   static u16 split_lo(u32 z) { return u16(z); }
+  static bool hi_zero(u32 z) { return z <= kLo; }
 };
 
 template<typename T>
@@ -66,9 +132,10 @@ struct BitConcatenator<T, sizeof(u32)> {
   static u64 merge(u32 hi, u32 lo) { return (u64(hi) << 32) | u64(lo); }
   static u32 split_hi(u64 z) { return u32(z >> 32); }
   static u32 split_lo(u64 z) { return u32(z); }
+  static bool hi_zero(u64 z) { return z <= kLo; }
 };
 
-ulong next_power_of_two(ulong n) {
+inline ulong next_power_of_two(ulong n) {
   n += !n;
   return static_cast<ulong>(1) << (sizeof(ulong) * 8 - 1 - __builtin_clzl(n+n-1));
 }
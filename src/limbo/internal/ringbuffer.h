@@ -2,77 +2,68 @@
 // Copyright 2019 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// RingBuffer that grows on demand.
+// RingBuffer that grows on demand. The capacity is a power of two, so that
+// indices wrap around with a mask, and the first kInlineCapacity elements are
+// stored inline, so that small buffers need no heap allocation.
 
 #ifndef LIMBO_INTERNAL_RINGBUFFER_H_
 #define LIMBO_INTERNAL_RINGBUFFER_H_
 
 #include <cassert>
+#include <type_traits>
 #include <utility>
 
-template<typename T>
+template<typename T, int kInlineCapacity = 8>
 class RingBuffer {
  public:
+  static_assert(kInlineCapacity > 0 && (kInlineCapacity & (kInlineCapacity - 1)) == 0,
+                "kInlineCapacity must be a power of two");
+
   RingBuffer() = default;
 
   RingBuffer(const RingBuffer&)            = delete;
   RingBuffer& operator=(const RingBuffer&) = delete;
 
-  RingBuffer(RingBuffer&& b)
-    : xs_(b.xs_),
-      capacity_(b.capacity_),
-      begin_(b.begin_),
-      end_(b.end_) {
-    b.xs_ = nullptr;
-    b.capacity_ = 0;
-    b.begin_ = 0;
-    b.end_ = 0;
-  }
-  RingBuffer& operator=(RingBuffer&& b) {
+  RingBuffer(RingBuffer&& b) noexcept(std::is_nothrow_move_assignable<T>::value) { Steal(&b); }
+  RingBuffer& operator=(RingBuffer&& b) noexcept(std::is_nothrow_move_assignable<T>::value) {
     if (this != &b) {
-      delete xs_;
-      xs_ = b.xs_;
-      capacity_ = b.capacity_;
-      begin_ = b.begin_;
-      end_ = b.end_;
-      b.xs_ = nullptr;
-      b.capacity_ = 0;
-      b.begin_ = 0;
-      b.end_ = 0;
+      Free();
+      Steal(&b);
     }
     return *this;
   }
 
-  ~RingBuffer() { delete[] xs_; }
+  ~RingBuffer() { Free(); }
 
-  int size()   const { return begin_ <= end_ ? end_ - begin_ : capacity_ - begin_ + end_; }
-  bool empty() const { return begin_ == end_; }
+  int size()   const { return size_; }
+  bool empty() const { return size_ == 0; }
 
-        T& operator[](int i)       { return xs_[(begin_ + i) % capacity_]; }
-  const T& operator[](int i) const { return xs_[(begin_ + i) % capacity_]; }
+        T& operator[](int i)       { assert(i < size_); return xs_[(begin_ + i) & mask()]; }
+  const T& operator[](int i) const { assert(i < size_); return xs_[(begin_ + i) & mask()]; }
 
   void PushFront(T&& x) {
     if (full()) {
       Grow();
     }
-    assert(!full());
     begin_ = pred(begin_);
     xs_[begin_] = std::move(x);
+    ++size_;
   }
 
   void PushFront(const T& x) {
     if (full()) {
       Grow();
     }
-    assert(!full());
     begin_ = pred(begin_);
     xs_[begin_] = x;
+    ++size_;
   }
 
   T PopFront() {
     assert(!empty());
     T x = std::move(xs_[begin_]);
     begin_ = succ(begin_);
+    --size_;
     return x;
   }
 
@@ -80,51 +71,79 @@ class RingBuffer {
     if (full()) {
       Grow();
     }
-    assert(!full());
-    xs_[end_] = std::move(x);
-    end_ = succ(end_);
+    xs_[(begin_ + size_) & mask()] = std::move(x);
+    ++size_;
   }
 
   void PushBack(const T& x) {
     if (full()) {
       Grow();
     }
-    assert(!full());
-    xs_[end_] = x;
-    end_ = succ(end_);
+    xs_[(begin_ + size_) & mask()] = x;
+    ++size_;
   }
 
   T PopBack() {
     assert(!empty());
-    end_ = pred(end_);
-    T x = std::move(xs_[end_]);
+    --size_;
+    T x = std::move(xs_[(begin_ + size_) & mask()]);
     return x;
   }
 
  private:
-  bool full() const { return xs_ == nullptr || size() == capacity_ - 1; }
+  bool inline_storage() const { return xs_ == inline_xs_; }
+  bool full()           const { return size_ == capacity_; }
+  int mask()            const { return capacity_ - 1; }
 
-  int succ(int i) const { return (i + 1) % capacity_; }
-  int pred(int i) const { return ((i - 1) + capacity_) % capacity_; }
+  int succ(int i) const { return (i + 1) & mask(); }
+  int pred(int i) const { return (i - 1) & mask(); }
 
   void Grow() {
-    const int new_capacity = capacity_ * 3 / 2 + 2;
+    const int new_capacity = 2 * capacity_;
     T* xs = new T[new_capacity];
-    const int s = size();
-    for (int i = 0; i < s; ++i) {
+    for (int i = 0; i < size_; ++i) {
       xs[i] = std::move((*this)[i]);
     }
-    delete[] xs_;
+    Free();
     xs_ = xs;
     capacity_ = new_capacity;
     begin_ = 0;
-    end_ = s;
   }
 
-  T* xs_ = nullptr;
-  int capacity_ = 0;
+  void Free() {
+    if (!inline_storage()) {
+      delete[] xs_;
+      xs_ = inline_xs_;
+      capacity_ = kInlineCapacity;
+    }
+  }
+
+  // Takes b's elements and leaves b empty; heap storage is taken over, inline
+  // elements are moved. Precondition: this uses inline storage.
+  void Steal(RingBuffer* b) {
+    assert(inline_storage());
+    if (b->inline_storage()) {
+      for (int i = 0; i < b->size_; ++i) {
+        inline_xs_[i] = std::move((*b)[i]);
+      }
+      begin_ = 0;
+    } else {
+      xs_ = b->xs_;
+      capacity_ = b->capacity_;
+      begin_ = b->begin_;
+      b->xs_ = b->inline_xs_;
+      b->capacity_ = kInlineCapacity;
+    }
+    size_ = b->size_;
+    b->begin_ = 0;
+    b->size_ = 0;
+  }
+
+  T inline_xs_[kInlineCapacity];
+  T* xs_ = inline_xs_;
+  int capacity_ = kInlineCapacity;
   int begin_ = 0;  // inclusive
-  int end_ = 0;  // exclusive
+  int size_ = 0;
 };
 
 #endif  // LIMBO_INTERNAL_RINGBUFFER_H_
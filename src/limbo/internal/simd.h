@@ -0,0 +1,58 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Thin wrappers around AVX2 integer intrinsics, specialized for the lane
+// width, so that a kernel can be written once for 32- and 64-bit integers.
+// Avx2 is only defined when the compiler targets AVX2 (__AVX2__); callers
+// need a scalar fallback otherwise.
+
+#ifndef LIMBO_INTERNAL_SIMD_H_
+#define LIMBO_INTERNAL_SIMD_H_
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+#ifdef __AVX2__
+
+struct Avx2Base {
+  using vec_t = __m256i;
+
+  static vec_t load(const void* p) { return _mm256_loadu_si256(static_cast<const vec_t*>(p)); }
+  static vec_t bit_xor(vec_t x, vec_t y) { return _mm256_xor_si256(x, y); }
+  static vec_t bit_and(vec_t x, vec_t y) { return _mm256_and_si256(x, y); }
+  static vec_t bit_or(vec_t x, vec_t y)  { return _mm256_or_si256(x, y); }
+  static vec_t and_not(vec_t x, vec_t y) { return _mm256_andnot_si256(x, y); }  // ~x & y
+  static bool any(vec_t x) { return !_mm256_testz_si256(x, x); }
+};
+
+template<typename T, int = sizeof(T)>
+struct Avx2 {};
+
+template<typename T>
+struct Avx2<T, sizeof(u32)> : Avx2Base {
+  static constexpr int kLanes = 8;
+  static vec_t set1(u32 x)           { return _mm256_set1_epi32(i32(x)); }
+  static vec_t eq(vec_t x, vec_t y)  { return _mm256_cmpeq_epi32(x, y); }
+};
+
+template<typename T>
+struct Avx2<T, sizeof(u64)> : Avx2Base {
+  static constexpr int kLanes = 4;
+  static vec_t set1(u64 x)           { return _mm256_set1_epi64x(i64(x)); }
+  static vec_t eq(vec_t x, vec_t y)  { return _mm256_cmpeq_epi64(x, y); }
+};
+
+#endif  // __AVX2__
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_SIMD_H_
+
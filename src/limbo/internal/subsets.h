@@ -2,7 +2,7 @@
 // Copyright 2019 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// Functions to determine all subsets.
+// Functions and iterative enumerators to determine all subsets.
 
 #ifndef LIMBO_INTERNAL_SUBSETS_H_
 #define LIMBO_INTERNAL_SUBSETS_H_
@@ -12,9 +12,249 @@
 #include <algorithm>
 #include <vector>
 
+#include <limbo/internal/ints.h>
+
 namespace limbo {
 namespace internal {
 
+inline u64 Binomial(const int n, const int k) {
+  if (k < 0 || k > n) {
+    return 0;
+  }
+  u64 c = 1;
+  for (int i = 1; i <= std::min(k, n - k); ++i) {
+    c = c * u64(n - i + 1) / u64(i);
+  }
+  return c;
+}
+
+// Enumerates the subsets of size k of {0,...,n-1} in colexicographic order,
+// that is, ordered by their largest element, then by their second largest,
+// and so on. Next() takes amortized constant time. The rank of a subset is
+// its position in this order, so that a range of ranks can be enumerated
+// independently after Unrank().
+class Combinations {
+ public:
+  explicit Combinations(const int n = 0, const int k = 0) : n_(n), k_(k), c_(std::max(0, k)) { Reset(); }
+
+  Combinations(const Combinations&)            = default;
+  Combinations& operator=(const Combinations&) = default;
+  Combinations(Combinations&&)                 = default;
+  Combinations& operator=(Combinations&&)      = default;
+
+  int n() const { return n_; }
+  int k() const { return k_; }
+  u64 count() const { return Binomial(n_, k_); }
+
+  bool valid() const { return valid_; }
+  int operator[](const int i) const { return c_[i]; }
+  std::vector<int>::const_iterator begin() const { return c_.begin(); }
+  std::vector<int>::const_iterator end()   const { return c_.end(); }
+
+  void Reset() {
+    for (int i = 0; i < k_; ++i) {
+      c_[i] = i;
+    }
+    valid_ = 0 <= k_ && k_ <= n_;
+  }
+
+  void Next() {
+    assert(valid_);
+    int i = 0;
+    while (i < k_ && c_[i] + 1 == (i + 1 < k_ ? c_[i + 1] : n_)) {
+      ++i;
+    }
+    if (i == k_) {
+      valid_ = false;
+      return;
+    }
+    ++c_[i];
+    for (int j = 0; j < i; ++j) {
+      c_[j] = j;
+    }
+  }
+
+  u64 rank() const {
+    assert(valid_);
+    u64 r = 0;
+    for (int i = 0; i < k_; ++i) {
+      r += Binomial(c_[i], i + 1);
+    }
+    return r;
+  }
+
+  void Unrank(u64 r) {
+    valid_ = 0 <= k_ && k_ <= n_ && r < count();
+    int c = n_;
+    for (int i = k_ - 1; i >= 0 && valid_; --i) {
+      do {
+        --c;
+      } while (Binomial(c, i + 1) > r);
+      c_[i] = c;
+      r -= Binomial(c, i + 1);
+    }
+  }
+
+ private:
+  int n_;
+  int k_;
+  std::vector<int> c_;
+  bool valid_ = false;
+};
+
+// Enumerates the subsets of size k of the union of buckets of the given sizes
+// that take elements from at least two buckets but not all elements of any
+// bucket. The subsets are grouped by how many elements they take from each
+// bucket; within such a group, the last bucket's elements change fastest.
+// Next() takes amortized constant time per bucket, and Prune(b) skips the
+// remaining subsets of the current group that agree with the current one on
+// the buckets up to b. Subsets of later groups are not skipped, even if they
+// agree with it on these buckets. Like Combinations, the subsets can be
+// ranked and unranked.
+class CombinedCombinations {
+ public:
+  explicit CombinedCombinations(const std::vector<int>& sizes, const int k)
+      : sizes_(sizes), k_(k), caps_(sizes.size()), counts_(sizes.size()), combs_(sizes.size()) {
+    max_suffix_.resize(sizes_.size() + 1, 0);
+    for (int b = int(sizes_.size()) - 1; b >= 0; --b) {
+      assert(sizes_[b] > 0);
+      caps_[b] = std::max(0, std::min(k_ - 1, sizes_[b] - 1));
+      max_suffix_[b] = caps_[b] + max_suffix_[b + 1];
+    }
+    Reset();
+  }
+
+  CombinedCombinations(const CombinedCombinations&)            = default;
+  CombinedCombinations& operator=(const CombinedCombinations&) = default;
+  CombinedCombinations(CombinedCombinations&&)                 = default;
+  CombinedCombinations& operator=(CombinedCombinations&&)      = default;
+
+  int buckets() const { return sizes_.size(); }
+
+  bool valid() const { return valid_; }
+  const Combinations& operator[](const int b) const { return combs_[b]; }
+
+  void Reset() {
+    counts_.assign(sizes_.size(), 0);
+    valid_ = !sizes_.empty() && k_ > 0 && FirstCounts(0, k_, &counts_);
+    if (valid_) {
+      ResetCombinations(0);
+    }
+  }
+
+  void Next() { Prune(buckets() - 1); }
+
+  // Advances to the next subset of the current group that differs from the
+  // current one on the buckets up to b, or to the first subset of the next
+  // group.
+  void Prune(int b) {
+    assert(valid_);
+    for (; b >= 0; --b) {
+      combs_[b].Next();
+      if (combs_[b].valid()) {
+        ResetCombinations(b + 1);
+        return;
+      }
+    }
+    valid_ = NextCounts(&counts_);
+    if (valid_) {
+      ResetCombinations(0);
+    }
+  }
+
+  u64 count() const {
+    u64 n = 0;
+    std::vector<int> counts(sizes_.size(), 0);
+    for (bool more = !sizes_.empty() && k_ > 0 && FirstCounts(0, k_, &counts); more; more = NextCounts(&counts)) {
+      n += count(counts);
+    }
+    return n;
+  }
+
+  u64 rank() const {
+    assert(valid_);
+    u64 r = 0;
+    std::vector<int> counts(sizes_.size(), 0);
+    for (FirstCounts(0, k_, &counts); counts != counts_; NextCounts(&counts)) {
+      r += count(counts);
+    }
+    u64 radix = 1;
+    for (int b = buckets() - 1; b >= 0; --b) {
+      r += combs_[b].rank() * radix;
+      radix *= combs_[b].count();
+    }
+    return r;
+  }
+
+  void Unrank(u64 r) {
+    Reset();
+    for (; valid_ && r >= count(counts_); valid_ = NextCounts(&counts_)) {
+      r -= count(counts_);
+    }
+    if (valid_) {
+      ResetCombinations(0);
+      for (int b = buckets() - 1; b >= 0; --b) {
+        const u64 n = combs_[b].count();
+        combs_[b].Unrank(r % n);
+        r /= n;
+      }
+    }
+  }
+
+ private:
+  // Sets the counts of the buckets from b on to the lexicographically
+  // smallest ones that sum up to k, if any.
+  bool FirstCounts(const int b, int k, std::vector<int>* counts) const {
+    if (k > max_suffix_[b]) {
+      return false;
+    }
+    for (int c = b; c < buckets(); ++c) {
+      (*counts)[c] = std::max(0, k - max_suffix_[c + 1]);
+      k -= (*counts)[c];
+    }
+    return true;
+  }
+
+  // Advances to the lexicographically next counts, if any.
+  bool NextCounts(std::vector<int>* counts) const {
+    int rest = counts->back();
+    for (int b = buckets() - 2; b >= 0; --b) {
+      if ((*counts)[b] < caps_[b] && rest > 0) {
+        ++(*counts)[b];
+        return FirstCounts(b + 1, rest - 1, counts);
+      }
+      rest += (*counts)[b];
+    }
+    return false;
+  }
+
+  u64 count(const std::vector<int>& counts) const {
+    u64 n = 1;
+    for (int b = 0; b < buckets(); ++b) {
+      n *= Binomial(sizes_[b], counts[b]);
+    }
+    return n;
+  }
+
+  void ResetCombinations(const int first) {
+    for (int b = first; b < buckets(); ++b) {
+      if (combs_[b].n() != sizes_[b] || combs_[b].k() != counts_[b]) {
+        combs_[b] = Combinations(sizes_[b], counts_[b]);
+      } else {
+        combs_[b].Reset();
+      }
+    }
+  }
+
+  std::vector<int> sizes_;
+  int k_;
+  std::vector<int> caps_;        // maximum count per bucket
+  std::vector<int> max_suffix_;  // sum of the caps from a bucket on
+  std::vector<int> counts_;      // current count per bucket
+  std::vector<Combinations> combs_;
+  bool valid_ = false;
+};
+
 template<typename SetContainer,
          typename UnaryPredicate,
          typename RandomAccessIt = typename SetContainer::const_iterator,
@@ -24,77 +264,48 @@ bool AllSubsetsOfSize(RandomAccessIt X_begin,
                       const int xs_wanted,
                       SetContainer* xs,
                       UnaryPredicate pred = UnaryPredicate()) {
-  int X_size = int(std::distance(X_begin, X_end));
-  if (xs_wanted == 0 || X_size == 0) {
-    return xs_wanted == 0 && pred(xs);
-  } else if (X_size < xs_wanted) {
+  const int X_size = int(std::distance(X_begin, X_end));
+  if (X_size < xs_wanted) {
     return false;
-  } else {
-    if (X_size > xs_wanted) {
-      const bool succ = AllSubsetsOfSize(std::next(X_begin), X_end, xs_wanted, xs, pred);
-      if (!succ) {
-        return false;
-      }
+  }
+  const int xs_size = xs->size();
+  bool succ = true;
+  for (Combinations c(X_size, xs_wanted); succ && c.valid(); c.Next()) {
+    xs->resize(xs_size);
+    for (const int i : c) {
+      xs->push_back(X_begin[i]);
     }
-    const T& x = *X_begin;
-    xs->push_back(x);
-    const bool succ = AllSubsetsOfSize(std::next(X_begin), X_end, xs_wanted - 1, xs, pred);
-    xs->pop_back();
-    return succ;
+    succ = pred(xs);
   }
+  xs->resize(xs_size);
+  return succ;
 }
 
 template<typename SetSetContainer,
          typename UnaryPredicate,
          typename SetContainer = typename SetSetContainer::value_type,
          typename T = typename SetContainer::value_type>
-bool AllCombinedSubsetsOfSize(const SetSetContainer& Xs,
-                              const std::vector<int>& n_not_yet_covered_in,
-                              const int xs_wanted,
-                              const int index,
-                              std::vector<T>* xs,
-                              UnaryPredicate pred = UnaryPredicate()) {
-  assert(index <= int(Xs.size()));
-  if (index == int(Xs.size())) {
-    return Xs.empty() || (xs_wanted == 0 && pred(*xs));
-  }
-  assert(!Xs[index].empty());
-  // What is the minimum number of functions we xs_wanted to assign from this bucket?
-  //     (xs_wanted - min_assign < n_not_yet_covered_in[index] - (n_not_yet_covered_in.size() - index - 1))
-  // <=> (min_assign > xs_wanted - n_not_yet_covered_in[index] + n_not_yet_covered_in.size() - index - 1)
-  // <=> (min_assign >= xs_wanted - n_not_yet_covered_in[index] + n_not_yet_covered_in.size() - index - 1)
-  const int min_assign = std::max(0,
-      xs_wanted - n_not_yet_covered_in[index] + int(n_not_yet_covered_in.size()) - index - 1);
-  // What is the maximum number of functions we can assign from this buckt?
-  const int max_assign = std::min(xs_wanted - xs->empty(), int(Xs[index].size()) - 1);
-  for (int i = min_assign; i <= max_assign; ++i) {
-    const bool succ = AllSubsetsOfSize(Xs[index].begin(), Xs[index].end(), i, xs, [&](std::vector<T>* xs) {
-      bool succ = AllCombinedSubsetsOfSize(Xs, n_not_yet_covered_in, xs_wanted - i, index + 1, xs, pred);
-      return succ;
-    });
-    if (!succ) {
+bool AllCombinedSubsetsOfSize(const SetSetContainer& Xs, const int xs_wanted, UnaryPredicate pred = UnaryPredicate()) {
+  std::vector<int> sizes;
+  for (const SetContainer& X : Xs) {
+    sizes.push_back(X.size());
+  }
+  std::vector<T> xs;
+  xs.reserve(std::max(0, xs_wanted));
+  for (CombinedCombinations cc(sizes, xs_wanted); cc.valid(); cc.Next()) {
+    xs.clear();
+    for (int b = 0; b < cc.buckets(); ++b) {
+      for (const int i : cc[b]) {
+        xs.push_back(Xs[b][i]);
+      }
+    }
+    if (!pred(xs)) {
       return false;
     }
   }
-  //std::printf("%d: true\n", __LINE__);
   return true;
 }
 
-template<typename SetSetContainer,
-         typename UnaryPredicate,
-         typename SetContainer = typename SetSetContainer::value_type,
-         typename T = typename SetContainer::value_type>
-bool AllCombinedSubsetsOfSize(const SetSetContainer& Xs, const int xs_wanted, UnaryPredicate pred = UnaryPredicate()) {
-  SetContainer xs;
-  std::vector<int> n_not_yet_covered_in(Xs.size());
-  for (int i = int(n_not_yet_covered_in.size()) - 2; i >= 0; --i) {
-    n_not_yet_covered_in[i] = int(Xs[i+1].size()) + n_not_yet_covered_in[i+1];
-  }
-  //for (int i = 0; i < Xs.size(); ++i) { printf("Xs[%d] =", i); for (const T f : Xs[i]) { printf(" %d", int(f)); } printf("\n"); }
-  //for (int i = 0; i < Xs.size(); ++i) { printf("n_not_yet_covered_in[%d] = %d\n", i, n_not_yet_covered_in[i]); } printf("\n");
-  return AllCombinedSubsetsOfSize(Xs, n_not_yet_covered_in, xs_wanted, 0, &xs, pred);
-}
-
 }  // namespace internal
 }  // namespace limbo
 
@@ -226,8 +226,8 @@ std::ostream& operator<<(std::ostream& os, const limbo::internal::Maybe<T>& m) {
 
 #ifdef LIMBO_SAT_H_
 #ifndef NDEBUG
-template<typename Activity>
-void Sat<Activity>::Print() const {
+template<typename Activity, template<typename> class FunQueue>
+void Sat<Activity, FunQueue>::Print() const {
   using limbo::io::operator<<;
   auto& o = std::cout;
   auto e = '\n';
@@ -297,15 +297,13 @@ void Sat<Activity>::Print() const {
           "reason = " << int(data_[f][n].reason) << "} " << e;
     }
   }
-  for (const Fun f : fun_activity_->keys()) {
-    o << "fun_activity_[" << f << "] = " << (*fun_activity_)[f] << e;
-  }
   o << "fun_queue_ =";
-  for (const Fun f : fun_queue_) {
-    o << " " << f;
+  for (const Fun f : model_.keys()) {
+    if (fun_queue_.contains(f)) {
+      o << " " << f;
+    }
   }
   o << e;
-  o << "fun_bump_step_ = " << fun_bump_step_ << e;
 }
 #endif
 #endif
@@ -20,13 +20,14 @@
 #define LIMBO_LIMSAT_H_
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iterator>
-#include <set>
 #include <vector>
 
 #include <limbo/formula.h>
 #include <limbo/sat.h>
+#include <limbo/internal/arena.h>
 #include <limbo/internal/dense.h>
 #include <limbo/internal/subsets.h>
 
@@ -36,6 +37,48 @@ class LimSat {
  public:
   using LitVec = std::vector<Lit>;
 
+  // kSat means the query is not believed, kUnsat means it is believed, and
+  // kUnknown means the budget was exhausted before either was established.
+  enum class Truth : char { kUnsat = -1, kUnknown = 0, kSat = 1 };
+
+  // Limits the effort of a single Solve() call; negative values mean no limit.
+  // The conflicts and models budgets count the conflicts and runs of the SAT
+  // solver, respectively. When a SAT run has found a partial model, it gives
+  // up after patience further conflicts and settles for that partial model.
+  struct Budget {
+    double seconds   = -1.0;
+    int    conflicts = -1;
+    int    models    = -1;
+    int    patience  = 50;
+  };
+
+  struct Statistics {
+    int relevant_clauses = 0;
+    int relevant_funs    = 0;
+    int conflicts        = 0;
+    int models           = 0;
+  };
+
+  // A Ladder carries the work of Solve() for a fixed query from one belief
+  // level to the next: a query believed at level k is believed at every level
+  // above k, a query not believed at level k is not believed at any level
+  // below k, and the counter-models found at level k seed the search at level
+  // k + 1. A Ladder starts over when clauses are added to the LimSat.
+  class Ladder {
+   public:
+    Ladder() = default;
+
+    void Reset() { *this = Ladder(); }
+
+   private:
+    friend class LimSat;
+
+    int                             revision_      = -1;
+    int                             believed_from_ = -1;
+    int                             refuted_upto_  = -1;
+    std::vector<TermMap<Fun, Name>> models_{};
+  };
+
   explicit LimSat() = default;
 
   LimSat(const LimSat&)            = delete;
@@ -47,17 +90,21 @@ class LimSat {
 
   bool AddClause(LitVec&& as) {
     std::sort(as.begin(), as.end());
-    auto p = clauses_.insert(std::move(as));
+    const auto p = clauses_.Insert(as);
     if (p.second) {
-      clauses_vec_.push_back(*p.first);
-      //clauses_not_yet_added_.push_back(p.first);
-      for (const Lit a : *p.first) {
+      ++revision_;
+      const int index = p.first;
+      for (const Lit a : clauses_[index]) {
         const Fun f = a.fun();
         const Name n = a.name();
         domains_.FitForKey(f);
         domains_[f].FitForKey(n);
         domains_[f][n] = true;
-        extra_name_id_ = std::max(n.id() + 1, extra_name_id_);
+        occurrences_.FitForKey(f);
+        if (occurrences_[f].empty() || occurrences_[f].back() != index) {
+          occurrences_[f].push_back(index);
+        }
+        extra_name_id_ = std::max(internal::u64(n.id()) + 1, extra_name_id_);
         if (!sat_.registered(f, n)) {
           sat_.Register(f, n);
         }
@@ -66,23 +113,64 @@ class LimSat {
     return p.second;
   }
 
-  void set_extra_name_contained(const bool b) { extra_name_contained_ = b; }
+  void set_extra_name_contained(const bool b) { extra_name_contained_ = b; ++revision_; }
   bool extra_name_contained() const { return extra_name_contained_; }
 
-  const std::set<LitVec>& clauses() const { return clauses_; }
+  // The relevance radius r restricts a query at belief level k to the clauses
+  // within r * (k + 1) hops from the query's functions in the function-clause
+  // incidence graph; a negative radius (the default) disables the filter.
+  // The literals derived by unit propagation from all clauses are added to
+  // the restricted problem, as is the empty clause if unit propagation leads
+  // to a conflict, so that the filter does not change the result at belief
+  // level 0. At higher levels, the filter is a heuristic: the consequences of
+  // splits may propagate beyond the bound.
+  void set_relevance_radius(const int r) { relevance_radius_ = r; ++revision_; }
+  int relevance_radius() const { return relevance_radius_; }
+
+  const Statistics& statistics() const { return stats_; }
+
+  const internal::ArenaSet<Lit>& clauses() const { return clauses_; }
 
   bool Solve(const int belief_level, const RFormula& query) {
-    UpdateDomainsForQuery(query);
-    auto query_pred = [&query](const TermMap<Fun, Name>& model, std::vector<Lit>* nogood) {
-      return query.SatisfiedBy(model, nogood);
-    };
-    auto model_found = [](const TermMap<Fun, Name>&) {};
-    bool sat = FindModels(belief_level, query_pred, model_found);
-    return sat;
+    return Solve(belief_level, query, Budget()) == Truth::kSat;
+  }
+
+  Truth Solve(const int belief_level, const RFormula& query, const Budget& budget) {
+    return Solve(belief_level, query, budget, nullptr);
+  }
+
+  // Solves the query like Solve() and reuses and updates the results from
+  // the ladder, which must not have been used with a different query.
+  bool Solve(const int belief_level, const RFormula& query, Ladder* ladder) {
+    return Solve(belief_level, query, Budget(), ladder) == Truth::kSat;
+  }
+
+  Truth Solve(const int belief_level, const RFormula& query, const Budget& budget, Ladder* ladder) {
+    return Solve(belief_level, budget, ladder,
+                 [this, &query]() { UpdateDomainsForQuery(query); return QueryFuns(query); },
+                 [&query](const TermMap<Fun, Name>& model, std::vector<Lit>* nogood) {
+                   return query.SatisfiedBy(model, nogood);
+                 });
+  }
+
+  // The following overloads solve a literal or a clause query, which are
+  // evaluated directly instead of through an RFormula.
+  bool  Solve(const int k, const Lit a)                                         { return Solve(k, &a, &a + 1, Budget(), nullptr) == Truth::kSat; }
+  Truth Solve(const int k, const Lit a, const Budget& budget)                   { return Solve(k, &a, &a + 1, budget, nullptr); }
+  bool  Solve(const int k, const Lit a, Ladder* ladder)                         { return Solve(k, &a, &a + 1, Budget(), ladder) == Truth::kSat; }
+  Truth Solve(const int k, const Lit a, const Budget& budget, Ladder* ladder)   { return Solve(k, &a, &a + 1, budget, ladder); }
+
+  bool  Solve(const int k, const LitVec& c)                                     { return Solve(k, c, Budget(), nullptr) == Truth::kSat; }
+  Truth Solve(const int k, const LitVec& c, const Budget& budget)               { return Solve(k, c, budget, nullptr); }
+  bool  Solve(const int k, const LitVec& c, Ladder* ladder)                     { return Solve(k, c, Budget(), ladder) == Truth::kSat; }
+  Truth Solve(const int k, const LitVec& c, const Budget& budget, Ladder* ladder) {
+    return Solve(k, c.data(), c.data() + c.size(), budget, ladder);
   }
 
   internal::Maybe<Name> Solve(const int belief_level, const Fun f) {
+    StartBudget(Budget());
     UpdateDomainsForQuery(f);
+    UpdateRelevance(belief_level, std::vector<Fun>{f});
     Name n;
     Formula query = Formula();
     // Find a first model without a set query (i.e., query is unsatisfiable) and
@@ -107,6 +195,75 @@ class LimSat {
  private:
   enum class Intensity { kCould, kShould, kMust };
 
+  // Solves the query that is checked by query_satisfied after prepare_query
+  // has been called, which returns the query's functions.
+  template<typename QueryPreparation, typename QueryPredicate>
+  Truth Solve(const int belief_level,
+              const Budget& budget,
+              Ladder* ladder,
+              QueryPreparation prepare_query,
+              QueryPredicate query_satisfied) {
+    StartBudget(budget);
+    if (ladder && ladder->revision_ != revision_) {
+      ladder->Reset();
+      ladder->revision_ = revision_;
+    }
+    if (ladder && ladder->believed_from_ >= 0 && ladder->believed_from_ <= belief_level) {
+      return Truth::kUnsat;
+    }
+    if (ladder && belief_level <= ladder->refuted_upto_) {
+      return Truth::kSat;
+    }
+    UpdateRelevance(belief_level, prepare_query());
+    auto model_found = [](const TermMap<Fun, Name>&) {};
+    std::vector<TermMap<Fun, Name>>* models = ladder && !relevance_active_ ? &ladder->models_ : nullptr;
+    const bool sat = FindModels(belief_level, query_satisfied, model_found, models);
+    if (ladder && sat) {
+      ladder->refuted_upto_ = std::max(belief_level, ladder->refuted_upto_);
+    } else if (ladder && !budget_exhausted_) {
+      ladder->believed_from_ = belief_level;
+      ladder->models_.clear();
+    }
+    return sat ? Truth::kSat : budget_exhausted_ ? Truth::kUnknown : Truth::kUnsat;
+  }
+
+  // Solves the clause [first, last).
+  Truth Solve(const int belief_level, const Lit* first, const Lit* last, const Budget& budget, Ladder* ladder) {
+    return Solve(belief_level, budget, ladder,
+                 [this, first, last]() {
+                   std::vector<Fun> funs;
+                   if (relevance_radius_ >= 0) {
+                     funs.reserve(last - first);
+                   }
+                   for (const Lit* a = first; a != last; ++a) {
+                     UpdateDomainsForQuery(*a);
+                     if (relevance_radius_ >= 0) {
+                       funs.push_back(a->fun());
+                     }
+                   }
+                   return funs;
+                 },
+                 [first, last](const TermMap<Fun, Name>& model, std::vector<Lit>* nogood) {
+                   return SatisfiedBy(model, first, last, nogood);
+                 });
+  }
+
+  // Does the same as RFormula::SatisfiedBy() for the clause [first, last).
+  static bool SatisfiedBy(const TermMap<Fun, Name>& model, const Lit* first, const Lit* last, std::vector<Lit>* reason) {
+    for (; first != last; ++first) {
+      const Lit a = *first;
+      const Fun f = a.fun();
+      const Name n = model.key_in_range(f) ? model[f] : Name();
+      if (!n.null() && a.pos() == (n == a.name())) {
+        if (reason != nullptr) {
+          reason->push_back(a);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
   struct FoundModel {
     FoundModel() = default;
     FoundModel(TermMap<Fun, Name>&& model) : model(std::move(model)), succ(true) {}
@@ -174,6 +331,14 @@ class LimSat {
     return model.key_in_range(f) && !model[f].null();
   }
 
+  static int ModelSize(const TermMap<Fun, Name>& model) {
+    int size = 0;
+    for (const Name n : model.values()) {
+      size += !n.null();
+    }
+    return size;
+  }
+
   static bool AssignsAll(const TermMap<Fun, Name>& model, const std::vector<Fun>& funs) {
     for (const Fun f : funs) {
       if (!assigns(model, f)) {
@@ -192,14 +357,6 @@ class LimSat {
     return true;
   }
 
-  static int AssignsNumber(const TermMap<Fun, Name>& model, const TermMap<Fun, bool>& wanted) {
-    int n = 0;
-    for (const Fun f : wanted.keys()) {
-      n += wanted[f] && assigns(model, f);
-    }
-    return n;
-  }
-
   template<typename T>
   static std::vector<Fun> Merge(const std::vector<T>& xs, const std::vector<Fun>& ys) {
     std::vector<Fun> zs;
@@ -224,8 +381,13 @@ class LimSat {
     return AssignedFunctions(std::move(newly_assigned), all_assigned);
   }
 
+  // If models is not null, its models seed the search, and it is replaced with
+  // the models found by the search.
   template<typename QueryPredicate, typename ModelFoundFunction>
-  bool FindModels(const int min_model_size, QueryPredicate query_satisfied, ModelFoundFunction model_found) {
+  bool FindModels(const int min_model_size,
+                  QueryPredicate query_satisfied,
+                  ModelFoundFunction model_found,
+                  std::vector<TermMap<Fun, Name>>* models = nullptr) {
     //printf("FindModels:%d\n", __LINE__);
     // Find models such that every function is assigned a value in some model.
     // For example, consider a problem with functions 1,2,3,4,5 and minimum
@@ -234,21 +396,33 @@ class LimSat {
     // covers all functions. M1 and M2 subsume models that assign the subsets
     // of cardinality of size 2 of {1,2,3} and {3,4,5}, that is,
     // {1,2}, {2,3}, {1,3}, and {3,4}, {4,5}, {3,5}.
-    const FoundCoveringModels fcm = FindCoveringModels(min_model_size, query_satisfied, model_found);
+    const std::vector<TermMap<Fun, Name>> no_seeds;
+    const FoundCoveringModels fcm = FindCoveringModels(min_model_size, models ? *models : no_seeds,
+                                                       query_satisfied, model_found);
     if (!fcm.all_covered) {
       return false;
     }
+    if (models) {
+      *models = fcm.models;
+    }
     // Now find models for sets for which models aren't implied yet.
     // In the example, the sets {{x,y} | x in {1,2,3}, y in {4,5}}.
+    std::vector<TermMap<Fun, Name>> found_models;
     return internal::AllCombinedSubsetsOfSize(fcm.newly_assigned_in, min_model_size,
                                               [&](const std::vector<Fun>& must) -> bool {
       // Skip sets of functions that have been covered already.
       // In the example, {3,4} and {3,5} are implied by M2.
+      // A model found for an earlier set may also cover later ones.
       for (const TermMap<Fun, Name>& model : fcm.models) {
         if (AssignsAll(model, must)) {
           return true;
         }
       }
+      for (const TermMap<Fun, Name>& model : found_models) {
+        if (AssignsAll(model, must)) {
+          return true;
+        }
+      }
       TermMap<Fun, bool> wanted;
       wanted.FitForKey(domains_.upper_bound_key(), false);
       for (const Fun f : must) {
@@ -256,13 +430,20 @@ class LimSat {
       }
       constexpr bool propagate_with_learnt = false;
       constexpr Intensity want_intensity = Intensity::kMust;
-      const FoundModel fm = FindModel(min_model_size, propagate_with_learnt, want_intensity, wanted, query_satisfied);
+      FoundModel fm = FindModel(min_model_size, propagate_with_learnt, want_intensity, wanted, query_satisfied);
+      if (fm.succ) {
+        if (models) {
+          models->push_back(fm.model);
+        }
+        found_models.push_back(std::move(fm.model));
+      }
       return fm.succ;
     });
   }
 
   template<typename QueryPredicate, typename ModelFoundFunction>
   FoundCoveringModels FindCoveringModels(const int min_model_size,
+                                         const std::vector<TermMap<Fun, Name>>& seeds,
                                          QueryPredicate query_satisfied,
                                          ModelFoundFunction model_found) {
     std::vector<TermMap<Fun, Name>> models;
@@ -270,13 +451,20 @@ class LimSat {
     TermMap<Fun, bool> wanted;
     wanted.FitForKey(domains_.upper_bound_key());
     for (const Fun f : domains_.keys()) {
-      wanted[f] = !domains_[f].empty();
+      wanted[f] = domains_[f].any() && relevant(f);
     }
     bool propagate_with_learnt = true;
     Intensity want_intensity = Intensity::kShould;
+    auto seed = seeds.begin();
     for (;;) {
-      const FoundModel fm = FindModel(min_model_size, propagate_with_learnt, want_intensity, wanted, query_satisfied);
-      if (propagate_with_learnt && !fm.succ) {
+      // Seeds that are large enough are used before any new model is sought.
+      while (seed != seeds.end() && ModelSize(*seed) < min_model_size) {
+        ++seed;
+      }
+      const bool seeded = seed != seeds.end();
+      const FoundModel fm = seeded ? FoundModel(*seed++) :
+          FindModel(min_model_size, propagate_with_learnt, want_intensity, wanted, query_satisfied);
+      if (!seeded && propagate_with_learnt && !fm.succ) {
         propagate_with_learnt = false;
         continue;
       }
@@ -285,6 +473,9 @@ class LimSat {
         want_intensity = Intensity::kCould;
         continue;
       }
+      if (seeded && gaf.newly_assigned.empty()) {
+        continue;
+      }
       if (!fm.succ || (min_model_size > 0 && gaf.newly_assigned.empty())) {
         return FoundCoveringModels();
       }
@@ -316,6 +507,10 @@ class LimSat {
                        const Intensity want_intensity,
                        const TermMap<Fun, bool>& wanted,
                        QueryPredicate query_satisfied) {
+    if (BudgetExhausted()) {
+      return FoundModel();
+    }
+    ++stats_.models;
     //printf("FindModel: min_model_size = %d, propagate_with_learnt = %s, want_intensity = %s, wanted =", min_model_size, propagate_with_learnt ? "true" : "false", want_intensity ? "true" : "false"); for (Fun f : wanted.keys()) { if (wanted[f]) { printf(" %d", f.id()); } } printf("\n");
     auto activity = [&wanted, want_intensity](Fun f) {
       return Activity(wanted.key_in_range(f) && wanted[f] ?
@@ -324,66 +519,75 @@ class LimSat {
                       -1.0 :
                       1.0);
     };
+    Sat<Activity>& solver = active_sat();
 #if 1
     InitSat(false && propagate_with_learnt, activity);
 #else
     sat_ = Sat<Activity>();
-    for (const auto& c : clauses_vec_) {
+    for (const auto c : clauses_) {
       for (const Lit a : c) {
         sat_.Register(a.fun(), a.name(), activity);
       }
     }
     if (!extra_name_contained_) {
-      sat_.RegisterExtraName(Name::FromId(extra_name_id_));
+      sat_.RegisterExtraName(Name::FromIdChecked(extra_name_id_));
     }
-    for (const auto& c : clauses_vec_) {
-      sat_.AddClause(c);
+    for (const auto c : clauses_) {
+      sat_.AddClause(c.size(), c.begin());
     }
     sat_.Reset(Sat<Activity>::KeepLearnt(propagate_with_learnt), activity);
 #endif
-    sat_.set_propagate_with_learnt(propagate_with_learnt);
+    solver.set_propagate_with_learnt(propagate_with_learnt);
+    solver.Untrack();
+    for (const Fun f : wanted.keys()) {
+      if (wanted[f]) {
+        solver.Track(f);
+      }
+    }
     TermMap<Fun, Name> partial_model;
     int partial_model_size = -1;
     int n_conflicts = 0;
     int partial_assigns_number = -1;
     int partial_last_conflict = -1;
-    const Sat<Activity>::Truth truth = sat_.Solve(
+    const Sat<Activity>::Truth truth = solver.Solve(
         [&](int, Sat<Activity>::CRef, const LitVec&, int) -> bool {
           ++n_conflicts;
-          return partial_last_conflict < 0 || n_conflicts - partial_last_conflict < kMaxConflicts;
+          ++stats_.conflicts;
+          return !BudgetExhausted() &&
+                 (partial_last_conflict < 0 || n_conflicts - partial_last_conflict < budget_.patience);
         },
         [&](int, Lit) -> bool {
           int assigns_number = -1;
-          if (min_model_size <= sat_.model_size() && partial_model_size < sat_.model_size() &&
-              (want_intensity < Intensity::kMust || AssignsAll(sat_.model(), wanted)) &&
+          if (min_model_size <= solver.model_size() && partial_model_size < solver.model_size() &&
+              (want_intensity < Intensity::kMust || solver.tracked_all_assigned()) &&
               !query_satisfied(partial_model, nullptr) &&
               (want_intensity == Intensity::kMust ||
-               (assigns_number = AssignsNumber(sat_.model(), wanted)) > partial_assigns_number)) {
-            partial_model_size     = sat_.model_size();
-            partial_model          = sat_.model();
+               (assigns_number = solver.tracked_model_size()) > partial_assigns_number)) {
+            partial_model_size     = solver.model_size();
+            partial_model          = solver.model();
             partial_last_conflict  = n_conflicts;
             partial_assigns_number = assigns_number;
           }
-          return true;
+          return !BudgetExhausted();
         },
         [&](const TermMap<Fun, Name>& model, LitVec* nogood) -> bool {
           const bool sat = query_satisfied(model, nogood);
           int assigns_number = -1;
-          if (!sat && min_model_size <= sat_.model_size() && partial_model_size < sat_.model_size() &&
-              (want_intensity < Intensity::kMust || AssignsAll(sat_.model(), wanted)) &&
+          if (!sat && min_model_size <= solver.model_size() && partial_model_size < solver.model_size() &&
+              (want_intensity < Intensity::kMust || solver.tracked_all_assigned()) &&
               (want_intensity == Intensity::kMust ||
-               (assigns_number = AssignsNumber(sat_.model(), wanted)) > partial_assigns_number)) {
-            partial_model_size     = sat_.model_size();
-            partial_model          = sat_.model();
+               (assigns_number = solver.tracked_model_size()) > partial_assigns_number)) {
+            partial_model_size     = solver.model_size();
+            partial_model          = solver.model();
             partial_last_conflict  = n_conflicts;
             partial_assigns_number = assigns_number;
           }
           return sat;
         });
     if (truth == Sat<Activity>::Truth::kSat) {
-      //printf("FindModel %d: true, partial_model_size = %d, assignment =", __LINE__, sat_.model_size()); for (const Fun f : sat_.model().keys()) { if (assigns(sat_.model(), f)) { printf(" (%d = %d)", f.id(), sat_.model()[f].id()); } } printf("\n");
-      assert(AssignsAll(sat_.model(), wanted));
-      return FoundModel(sat_.model());
+      //printf("FindModel %d: true, partial_model_size = %d, assignment =", __LINE__, solver.model_size()); for (const Fun f : solver.model().keys()) { if (assigns(solver.model(), f)) { printf(" (%d = %d)", f.id(), solver.model()[f].id()); } } printf("\n");
+      assert(AssignsAll(solver.model(), wanted));
+      return FoundModel(solver.model());
     } else if (partial_model_size >= min_model_size) {
       //printf("FindModel %d: true, partial_model_size = %d, assignment =", __LINE__, partial_model_size); for (const Fun f : partial_model.keys()) { if (assigns(partial_model, f)) { printf(" (%d = %d)", f.id(), partial_model[f].id()); } } printf("\n");
       return FoundModel(std::move(partial_model));
@@ -396,49 +600,263 @@ class LimSat {
   void UpdateDomainsForQuery(const RFormula& query) {
     for (const Alphabet::Symbol& s : query) {
       if (s.tag == Alphabet::Symbol::kStrippedLit) {
-        const Fun f = s.u.a.fun();
-        const Name n = s.u.a.name();
-        domains_.FitForKey(f);
-        domains_[f].FitForKey(n, false);
-        if (!domains_[f][n]) {
-          domains_[f][n] = true;
-          extra_name_id_ = std::max(n.id() + 1, extra_name_id_);
-          sat_.Register(f, n);
-        }
+        UpdateDomainsForQuery(s.u.a);
       } else {
         assert(!s.stripped());
       }
     }
   }
 
+  void UpdateDomainsForQuery(const Lit a) {
+    const Fun f = a.fun();
+    const Name n = a.name();
+    domains_.FitForKey(f);
+    domains_[f].FitForKey(n);
+    if (!domains_[f][n]) {
+      domains_[f][n] = true;
+      extra_name_id_ = std::max(internal::u64(n.id()) + 1, extra_name_id_);
+      sat_.Register(f, n);
+      ++domains_revision_;
+    }
+  }
+
   void UpdateDomainsForQuery(const Fun f) {
     domains_.FitForKey(f);
   }
 
+  void StartBudget(const Budget& budget) {
+    budget_ = budget;
+    budget_exhausted_ = false;
+    if (budget_.seconds >= 0.0) {
+      deadline_ = std::chrono::steady_clock::now() +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(budget_.seconds));
+    }
+    stats_ = Statistics();
+  }
+
+  bool BudgetExhausted() {
+    if (!budget_exhausted_) {
+      budget_exhausted_ = (budget_.conflicts >= 0 && stats_.conflicts >= budget_.conflicts) ||
+                          (budget_.models >= 0 && stats_.models >= budget_.models) ||
+                          (budget_.seconds >= 0.0 && std::chrono::steady_clock::now() >= deadline_);
+    }
+    return budget_exhausted_;
+  }
+
+  static std::vector<Fun> QueryFuns(const RFormula& query) {
+    std::vector<Fun> funs;
+    for (const Alphabet::Symbol& s : query) {
+      if (s.tag == Alphabet::Symbol::kStrippedLit) {
+        funs.push_back(s.u.a.fun());
+      }
+    }
+    return funs;
+  }
+
+  bool relevant(const Fun f) const {
+    return !relevance_active_ || (relevant_funs_.key_in_range(f) && relevant_funs_[f]);
+  }
+
+  Sat<Activity>& active_sat() { return relevance_active_ ? relevant_sat_ : sat_; }
+
+  // Breadth-first search over the function-clause incidence graph, starting
+  // from the query's functions. Every clause within the distance bound is
+  // loaded into relevant_sat_, which then replaces sat_ for this query,
+  // together with the base units on the relevant functions. relevant_sat_ is
+  // only rebuilt when the query's functions, the bound, or the clauses change.
+  void UpdateRelevance(const int belief_level, std::vector<Fun> query_funs) {
+    relevance_active_ = relevance_radius_ >= 0 && !query_funs.empty();
+    if (!relevance_active_) {
+      stats_.relevant_clauses = clauses_.size();
+      stats_.relevant_funs = 0;
+      for (const Fun f : domains_.keys()) {
+        stats_.relevant_funs += domains_[f].any();
+      }
+      return;
+    }
+    const int max_distance = relevance_radius_ * (belief_level + 1);
+    std::sort(query_funs.begin(), query_funs.end());
+    query_funs.erase(std::unique(query_funs.begin(), query_funs.end()), query_funs.end());
+    if (relevance_revision_ == revision_ && relevance_domains_revision_ == domains_revision_ &&
+        relevance_distance_ == max_distance && relevance_funs_ == query_funs) {
+      stats_.relevant_clauses = relevance_stats_.relevant_clauses;
+      stats_.relevant_funs = relevance_stats_.relevant_funs;
+      return;
+    }
+    UpdateBaseUnits();
+    relevant_funs_.Clear();
+    relevant_funs_.FitForIndex(domains_.upper_bound_index(), false);
+    std::vector<bool> clause_seen(clauses_.size(), false);
+    std::vector<int> relevant_clauses;
+    std::vector<Fun> funs;
+    std::vector<Fun> frontier;
+    std::vector<Fun> next_frontier;
+    for (const Fun f : query_funs) {
+      if (!relevant_funs_[f]) {
+        relevant_funs_[f] = true;
+        funs.push_back(f);
+        frontier.push_back(f);
+      }
+    }
+    for (int distance = 0; distance < max_distance && !frontier.empty(); ++distance) {
+      next_frontier.clear();
+      for (const Fun f : frontier) {
+        if (!occurrences_.key_in_range(f)) {
+          continue;
+        }
+        for (const int i : occurrences_[f]) {
+          if (clause_seen[i]) {
+            continue;
+          }
+          clause_seen[i] = true;
+          relevant_clauses.push_back(i);
+          for (const Lit a : clauses_[i]) {
+            const Fun g = a.fun();
+            if (!relevant_funs_[g]) {
+              relevant_funs_[g] = true;
+              funs.push_back(g);
+              next_frontier.push_back(g);
+            }
+          }
+        }
+      }
+      std::swap(frontier, next_frontier);
+    }
+    relevant_sat_ = Sat<Activity>();
+    for (const Fun f : funs) {
+      if (domains_.key_in_range(f)) {
+        for (const Name n : domains_[f].keys()) {
+          if (domains_[f][n]) {
+            relevant_sat_.Register(f, n);
+          }
+        }
+      }
+    }
+    if (!extra_name_contained_) {
+      relevant_sat_.RegisterExtraName(Name::FromIdChecked(extra_name_id_));
+    }
+    // The base units come first, so that AddClause() watches the clauses
+    // accordingly.
+    if (!base_consistent_) {
+      relevant_sat_.AddClause(0, nullptr);
+    } else {
+      for (const Lit a : base_units_) {
+        if (relevant_funs_[a.fun()]) {
+          relevant_sat_.AddLiteral(a);
+        }
+      }
+    }
+    for (const int i : relevant_clauses) {
+      const internal::ArenaSet<Lit>::Range c = clauses_[i];
+      relevant_sat_.AddClause(c.size(), c.begin());
+    }
+    stats_.relevant_clauses = relevant_clauses.size();
+    stats_.relevant_funs = funs.size();
+    relevance_revision_ = revision_;
+    relevance_domains_revision_ = domains_revision_;
+    relevance_distance_ = max_distance;
+    relevance_funs_ = std::move(query_funs);
+    relevance_stats_ = stats_;
+  }
+
+  // Computes the literals that unit propagation derives from all clauses.
+  // They do not depend on the query and are cached per revision and domains.
+  void UpdateBaseUnits() {
+    if (base_units_revision_ == revision_ && base_units_domains_revision_ == domains_revision_) {
+      return;
+    }
+    base_units_revision_ = revision_;
+    base_units_domains_revision_ = domains_revision_;
+    base_units_.clear();
+    Sat<Activity> sat;
+    for (const Fun f : domains_.keys()) {
+      for (const Name n : domains_[f].keys()) {
+        if (domains_[f][n]) {
+          sat.Register(f, n);
+        }
+      }
+    }
+    if (!extra_name_contained_) {
+      sat.RegisterExtraName(Name::FromIdChecked(extra_name_id_));
+    }
+    for (int i = 0; i < clauses_.size(); ++i) {
+      const internal::ArenaSet<Lit>::Range c = clauses_[i];
+      sat.AddClause(c.size(), c.begin());
+    }
+    base_consistent_ = sat.PropagateBase(&base_units_);
+  }
+
   template<typename ActivityFunction>
   void InitSat(const bool keep_learnt, ActivityFunction activity = ActivityFunction()) {
-    if (!extra_name_contained_) {
-      sat_.RegisterExtraName(Name::FromId(extra_name_id_));
-      extra_name_contained_ = true;
+    if (relevance_active_) {
+      relevant_sat_.Reset(Sat<Activity>::KeepLearnt{keep_learnt}, activity);
+      return;
+    }
+    if (!extra_name_contained_ && !extra_name_registered_) {
+      sat_.RegisterExtraName(Name::FromIdChecked(extra_name_id_));
+      extra_name_registered_ = true;
     }
     sat_.Reset(Sat<Activity>::KeepLearnt{keep_learnt}, activity);
-    for (; sat_init_index_ < int(clauses_vec_.size()); ++sat_init_index_) {
-      sat_.AddClause(clauses_vec_[sat_init_index_]);
+    for (; sat_init_index_ < clauses_.size(); ++sat_init_index_) {
+      const internal::ArenaSet<Lit>::Range c = clauses_[sat_init_index_];
+      sat_.AddClause(c.size(), c.begin());
     }
   }
 
   static constexpr double kActivityOffset = 1000.0;
-  static constexpr int    kMaxConflicts   = 50;
 
-  std::set<LitVec>    clauses_{};
-  std::vector<LitVec> clauses_vec_{};
+  // clauses_ contains every clause once, sorted, and in insertion order.
+  internal::ArenaSet<Lit> clauses_{};
 
-  TermMap<Fun, TermMap<Name, bool>> domains_{};
-  Name::id_t                        extra_name_id_ = 1;
+  // occurrences_ maps every function to the ids of the clauses in clauses_
+  //    that mention it.
+  TermMap<Fun, std::vector<int>>    occurrences_{};
+  TermMatrix<Fun, Name, bool>       domains_{};
+  internal::u64                     extra_name_id_ = 1;
   bool                              extra_name_contained_ = false;
+  bool                              extra_name_registered_ = false;
 
   Sat<Activity> sat_{};
   int           sat_init_index_ = 0;
+
+  // relevant_sat_ contains only the clauses that are relevant for the
+  //    current query if relevance_active_ is true.
+  int                relevance_radius_ = -1;
+  bool               relevance_active_ = false;
+  TermMap<Fun, bool> relevant_funs_{};
+  Sat<Activity>      relevant_sat_{};
+
+  // relevant_sat_ was built for the sorted query functions relevance_funs_,
+  //    the distance bound relevance_distance_, relevance_revision_, and
+  //    relevance_domains_revision_.
+  std::vector<Fun> relevance_funs_{};
+  int              relevance_distance_ = -1;
+  int              relevance_revision_ = -1;
+  int              relevance_domains_revision_ = -1;
+  Statistics       relevance_stats_{};
+
+  // base_units_ are the literals derived by unit propagation from all
+  //    clauses at base_units_revision_ and base_units_domains_revision_,
+  //    unless base_consistent_ is false.
+  std::vector<Lit> base_units_{};
+  bool             base_consistent_ = true;
+  int              base_units_revision_ = -1;
+  int              base_units_domains_revision_ = -1;
+
+  // budget_ limits the current Solve() call; deadline_ is only meaningful if
+  // budget_.seconds is non-negative.
+  Budget                                budget_{};
+  bool                                  budget_exhausted_ = false;
+  std::chrono::steady_clock::time_point deadline_{};
+
+  Statistics stats_{};
+
+  // revision_ is incremented whenever a change invalidates Ladders, and
+  // domains_revision_ whenever a query adds a name to a domain, which changes
+  // the extra name and invalidates relevant_sat_ and base_units_.
+  int revision_ = 0;
+  int domains_revision_ = 0;
 };
 
 }  // namespace limbo
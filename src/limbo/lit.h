@@ -4,24 +4,52 @@
 //
 // A literal is an equality or inequality of a function and a name.
 // Fun, Name, Lit are trivial types and not zero-initialized implicitly.
+//
+// A Lit merges the function and name (and the sign) into one integer. By
+// default, their bits are interleaved; defining LIMBO_LIT_CONCAT puts the
+// function in the upper and the name in the lower half instead, which avoids
+// pdep and pext. The choice affects the order of literals, but nothing else.
+//
+// With LIMBO_COMPACT_LIT defined, functions and names have 16-bit ids and
+// literals are 32 bits wide, which halves the memory of clauses but limits
+// the number of functions and names. FromIdChecked() aborts when an id
+// exceeds that limit.
 
 #ifndef LIMBO_LIT_H_
 #define LIMBO_LIT_H_
 
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <type_traits>
 
 #include <limbo/internal/ints.h>
 #include <limbo/internal/dense.h>
+#include <limbo/internal/simd.h>
 
 namespace limbo {
 
 class Fun {
  public:
+#ifdef LIMBO_COMPACT_LIT
+  using id_t = internal::u16;
+#else
   using id_t = internal::u32;
+#endif
+
+  static constexpr id_t kMaxId = id_t(~id_t(0));
 
   static Fun FromId(const id_t id) { return Fun(id); }
 
+  static Fun FromIdChecked(const internal::u64 id) {
+    if (id > kMaxId) {
+      std::fprintf(stderr, "Fun id %llu exceeds maximum %u\n",
+                   static_cast<unsigned long long>(id), static_cast<unsigned>(kMaxId));
+      std::abort();
+    }
+    return Fun(id_t(id));
+  }
+
   explicit Fun() = default;
 
   Fun(const Fun&)            = default;
@@ -52,8 +80,20 @@ class Name {
  public:
   using id_t = Fun::id_t;
 
+  // Lit needs one bit for the sign.
+  static constexpr id_t kMaxId = id_t(~id_t(0)) >> 1;
+
   static Name FromId(const id_t id) { return Name(id); }
 
+  static Name FromIdChecked(const internal::u64 id) {
+    if (id > kMaxId) {
+      std::fprintf(stderr, "Name id %llu exceeds maximum %u\n",
+                   static_cast<unsigned long long>(id), static_cast<unsigned>(kMaxId));
+      std::abort();
+    }
+    return Name(id_t(id));
+  }
+
   explicit Name() = default;
 
   Name(const Name&)            = default;
@@ -75,14 +115,18 @@ class Name {
  private:
   static_assert(sizeof(id_t) <= sizeof(int), "Name::id_t must be smaller than int");
 
-  explicit Name(const id_t id) : id_(id) { assert(!null()); }
+  explicit Name(const id_t id) : id_(id) { assert(!null() && id <= kMaxId); }
 
   id_t id_;
 };
 
 class Lit {
  public:
+#ifdef LIMBO_COMPACT_LIT
+  using id_t = internal::u32;
+#else
   using id_t = internal::u64;
+#endif
 
   static Lit Eq(const Fun fun, const Name name) { return Lit(true, fun, name); }
   static Lit Neq(const Fun fun, const Name name) { return Lit(false, fun, name); }
@@ -125,7 +169,7 @@ class Lit {
   // (f != n1), (f != n2) for distinct n1, n2.
   static bool Valid(const Lit a, const Lit b) {
     const id_t x = a.id_ ^ b.id_;
-    return x == 1 || (x != 0 && a.neg() && b.neg() && (x & Bits::kHi) == 0);
+    return x == 1 || (x != 0 && a.neg() && b.neg() && Bits::hi_zero(x));
   }
 
   // Complementary(a, b) holds when a, b match one of the following:
@@ -134,19 +178,50 @@ class Lit {
   // (f == n1), (f == n2) for distinct n1, n2.
   static bool Complementary(const Lit a, const Lit b) {
     const id_t x = a.id_ ^ b.id_;
-    return x == 1 || (x != 0 && a.pos() && b.pos() && (x & Bits::kHi) == 0);
+    return x == 1 || (x != 0 && a.pos() && b.pos() && Bits::hi_zero(x));
   }
 
   // ProperlySubsumes(a, b) holds when a is (f == n1) and b is (f != n2) for distinct n1, n2.
   static bool ProperlySubsumes(const Lit a, const Lit b) {
     const id_t x = a.id_ ^ b.id_;
-    return x != 1 && (x & 1) && a.pos() && (x & Bits::kHi) == 0;
+    return x != 1 && (x & 1) && a.pos() && Bits::hi_zero(x);
   }
 
   // Subsumes(a, b) holds when a == b or ProperlySubsumes(a, b).
   static bool Subsumes(const Lit a, const Lit b) {
     const id_t x = a.id_ ^ b.id_;
-    return x == 0 || (x != 1 && (x & 1) && a.pos() && (x & Bits::kHi) == 0);
+    return x == 0 || (x != 1 && (x & 1) && a.pos() && Bits::hi_zero(x));
+  }
+
+  // SubsumesAny(a, first, last) holds when Subsumes(a, b) for some b in
+  // [first, last). With AVX2, it tests blocks of four (or, with 32-bit
+  // literals, eight) literals at once.
+  static bool SubsumesAny(const Lit a, const Lit* first, const Lit* last) {
+    // With x = a.id_ ^ b.id_, Subsumes(a, b) holds iff x == 0, or a is
+    // positive and x is 1 in the sign bit and in no fun bit, but x != 1.
+    // For negative a, the second disjunct is disabled by an all-zero mask.
+#ifdef __AVX2__
+    using V = internal::Avx2<id_t>;
+    static_assert(sizeof(Lit) == sizeof(id_t), "Lit must be represented by its id");
+    const V::vec_t va   = V::set1(a.id_);
+    const V::vec_t zero = V::set1(0);
+    const V::vec_t one  = V::set1(1);
+    const V::vec_t mask = V::set1(a.pos() ? Bits::kHi | 1 : 0);
+    for (; last - first >= V::kLanes; first += V::kLanes) {
+      const V::vec_t x = V::bit_xor(va, V::load(first));
+      const V::vec_t eq = V::eq(x, zero);
+      const V::vec_t properly = V::and_not(V::eq(x, one), V::eq(V::bit_and(x, mask), one));
+      if (V::any(V::bit_or(eq, properly))) {
+        return true;
+      }
+    }
+#endif
+    for (; first != last; ++first) {
+      if (Subsumes(a, *first)) {
+        return true;
+      }
+    }
+    return false;
   }
 
   bool Subsumes(const Lit b) const { return Subsumes(*this, b); }
@@ -154,7 +229,11 @@ class Lit {
   bool ProperlySubsumes(const Lit b) const { return ProperlySubsumes(*this, b); }
 
  private:
+#ifdef LIMBO_LIT_CONCAT
+  using Bits = internal::BitConcatenator<Fun::id_t>;
+#else
   using Bits = internal::BitInterleaver<Fun::id_t>;
+#endif
 
   static_assert(sizeof(Fun::id_t) == sizeof(Name::id_t), "Fun::id_t and Name::id_t must be identical");
   static_assert(sizeof(Fun::id_t) + sizeof(Name::id_t) == sizeof(id_t), "Fun::id_t and Name::id_t must fit in id_t");
@@ -181,9 +260,17 @@ struct IdToTerm {
 template<typename T, typename Val, typename BoundCheck = internal::NoBoundCheck>
 using TermMap = internal::DenseMap<T, Val, typename T::id_t, 1, TermToId<T>, IdToTerm<T>, BoundCheck>;
 
+template<typename T, typename U, typename Val>
+using TermMatrix =
+    internal::DenseMatrix<T, U, Val, typename T::id_t, 1, TermToId<T>, IdToTerm<T>, TermToId<U>, IdToTerm<U>>;
+
 template<typename T, typename Less, typename BoundCheck = internal::NoBoundCheck>
 using MinHeap = internal::DenseMinHeap<T, Less, typename T::id_t, 1, TermToId<T>, IdToTerm<T>, BoundCheck>;
 
+template<typename T, typename Priority, typename Less, int kArity = 4, typename BoundCheck = internal::NoBoundCheck>
+using DaryMinHeap =
+    internal::DenseDaryMinHeap<T, Priority, Less, kArity, typename T::id_t, 1, TermToId<T>, IdToTerm<T>, BoundCheck>;
+
 }  // namespace limbo
 
 #endif  // LIMBO_LIT_H_
@@ -21,7 +21,6 @@
 
 #include <cstdlib>
 #include <algorithm>
-#include <memory>
 #include <utility>
 #include <vector>
 
@@ -32,7 +31,210 @@
 
 namespace limbo {
 
-template<typename Activity = double>
+// A function queue decides which function Sat assigns next. Functions that
+// take part in conflicts are bumped. The queue contains at least every
+// registered function that is not assigned.
+//
+// ActivityQueue picks the function with the highest activity, which grows
+// with every bump by a step that itself grows over time.
+template<typename Activity>
+class ActivityQueue {
+ public:
+  void FitForIndex(const int i) {
+    heap_.FitForIndex(i);
+    activity_.FitForIndex(i);
+  }
+
+  bool contains(const Fun f) const { return heap_.contains(f); }
+
+  void Register(const Fun f, const Activity a) {
+    activity_[f] = a;
+    heap_.Insert(f, a);
+  }
+
+  void Unassign(const Fun f) {
+    if (!heap_.contains(f)) {
+      heap_.Insert(f, activity_[f]);
+    }
+  }
+
+  template<typename AssignedPredicate>
+  Fun Next(AssignedPredicate assigned) {
+    Fun f;
+    do {
+      f = heap_.top();
+      if (f.null()) {
+        break;
+      }
+      heap_.Remove(f);
+    } while (assigned(f));
+    return f;
+  }
+
+  void Bump(const Fun f, bool)        { Bump(f, bump_step_); }
+  void BumpToFront(const Fun f, bool) { Bump(f, kDecayThreshold); }
+  void Decay()                        { bump_step_ *= kBumpMultiplier; }
+  void ResetBumps()                   { bump_step_ = kBumpStepInit; }
+
+  template<typename ActivityFunction>
+  void Reassign(ActivityFunction activity) {
+    for (const Fun f : activity_.keys()) {
+      const Activity old_act = activity_[f];
+      const Activity new_act = activity(f);
+      activity_[f] = new_act;
+      if (heap_.contains(f)) {
+        if (new_act > old_act) {
+          heap_.Increase(f, new_act);
+        } else if (old_act > new_act) {
+          heap_.Decrease(f, new_act);
+        }
+      }
+    }
+  }
+
+ private:
+  struct ActivityCompare {
+    bool operator()(const Activity& a1, const Activity& a2) const { return a1 > a2; }
+  };
+
+  static constexpr double kBumpStepInit   = 1.0;
+  static constexpr double kBumpMultiplier = 1.05;
+  static constexpr double kDecayThreshold = 1e100;
+
+  void Bump(const Fun f, const double bump) {
+    assert(bump >= 0);
+    activity_[f] += bump;
+    if (activity_[f] > kDecayThreshold) {
+      for (Activity& a : activity_.values()) {
+        a /= kDecayThreshold;
+      }
+      heap_.TransformPriorities([](Activity& a) { a /= kDecayThreshold; });
+      bump_step_ /= kDecayThreshold;
+    }
+    if (heap_.contains(f)) {
+      heap_.Increase(f, activity_[f]);
+    }
+  }
+
+  // activity_ assigns an activity to each function.
+  // heap_ ranks the functions by activity (highest first); it keeps a copy of
+  //    the activity of every function it contains.
+  TermMap<Fun, Activity>                      activity_{};
+  DaryMinHeap<Fun, Activity, ActivityCompare> heap_{};
+  double                                      bump_step_ = kBumpStepInit;
+};
+
+// MoveToFrontQueue (VMTF) keeps the functions in a doubly linked list and
+// moves every bumped function to its front, which takes constant time. Every
+// function has a timestamp that grows towards the front. A search cursor
+// maintains the invariant that all functions in front of it are assigned:
+// Next() walks from the cursor towards the back to the first unassigned
+// function, and Unassign() and Bump() move the cursor forward to an unassigned
+// function that lies in front of it. Activities only matter for Reassign(),
+// which sorts the list by them.
+template<typename Activity>
+class MoveToFrontQueue {
+ public:
+  void FitForIndex(const int i) { links_.FitForIndex(i); }
+
+  bool contains(const Fun f) const { return links_[f].stamp != 0; }
+
+  void Register(const Fun f, Activity) {
+    Enqueue(f);
+    search_ = f;
+  }
+
+  void Unassign(const Fun f) {
+    if (search_.null() || links_[f].stamp > links_[search_].stamp) {
+      search_ = f;
+    }
+  }
+
+  template<typename AssignedPredicate>
+  Fun Next(AssignedPredicate assigned) {
+    while (!search_.null() && assigned(search_)) {
+      search_ = links_[search_].prev;
+    }
+    return search_;
+  }
+
+  void Bump(const Fun f, const bool assigned) {
+    if (f != front_) {
+      Dequeue(f);
+      Enqueue(f);
+    }
+    if (!assigned) {
+      search_ = f;
+    }
+  }
+
+  void BumpToFront(const Fun f, const bool assigned) { Bump(f, assigned); }
+  void Decay()      {}
+  void ResetBumps() {}
+
+  // Sorts the list by activity so that the most active function is in front;
+  // functions with equal activity keep their order.
+  template<typename ActivityFunction>
+  void Reassign(ActivityFunction activity) {
+    std::vector<std::pair<Fun, Activity>> funs;
+    for (Fun f = back_; !f.null(); f = links_[f].next) {
+      funs.push_back(std::make_pair(f, activity(f)));
+    }
+    std::stable_sort(funs.begin(), funs.end(), [](const std::pair<Fun, Activity>& p1,
+                                                  const std::pair<Fun, Activity>& p2) { return p2.second > p1.second; });
+    back_ = Fun();
+    front_ = Fun();
+    for (const std::pair<Fun, Activity>& p : funs) {
+      Enqueue(p.first);
+    }
+    search_ = front_;
+  }
+
+ private:
+  struct Link {
+    Fun            prev{};     // towards the back
+    Fun            next{};     // towards the front
+    internal::u64  stamp = 0;  // 0 iff not registered
+  };
+
+  void Enqueue(const Fun f) {
+    Link& l = links_[f];
+    l.prev = front_;
+    l.next = Fun();
+    l.stamp = ++stamp_;
+    if (!front_.null()) {
+      links_[front_].next = f;
+    } else {
+      back_ = f;
+    }
+    front_ = f;
+  }
+
+  void Dequeue(const Fun f) {
+    const Link& l = links_[f];
+    if (!l.prev.null()) {
+      links_[l.prev].next = l.next;
+    } else {
+      back_ = l.next;
+    }
+    if (!l.next.null()) {
+      links_[l.next].prev = l.prev;
+    } else {
+      front_ = l.prev;
+    }
+    if (search_ == f) {
+      search_ = !l.next.null() ? l.next : l.prev;
+    }
+  }
+
+  TermMap<Fun, Link> links_{};
+  Fun                back_{};
+  Fun                front_{};
+  Fun                search_{};
+  internal::u64      stamp_ = 0;
+};
+
+template<typename Activity = double, template<typename> class FunQueue = ActivityQueue>
 class Sat {
  public:
   enum class Truth : char { kUnsat = -1, kUnknown = 0, kSat = 1 };
@@ -53,8 +255,7 @@ class Sat {
     assert(current_level() == Level::kBase && trail_.empty() && clauses_.size() == 1);
     FitMaps(f, n);
     if (!fun_queue_.contains(f)) {
-      (*fun_activity_)[f] = activity(f);
-      fun_queue_.Insert(f);
+      fun_queue_.Register(f, activity(f));
     }
     if (!data_[f][n].occurs) {
       data_[f][n].occurs = true;
@@ -87,22 +288,24 @@ class Sat {
     Enqueue(a, CRef::kNull);
   }
 
-  void AddClause(const std::vector<Lit>& as) {
-    if (as.size() == 0) {
+  void AddClause(const std::vector<Lit>& as) { AddClause(as.size(), as.data()); }
+
+  void AddClause(const int k, const Lit* as) {
+    if (k == 0) {
       empty_clause_ = true;
-    } else if (as.size() == 1) {
+    } else if (k == 1) {
       AddLiteral(as[0]);
     } else {
-      const CRef cr = clausef_.New(as);
+      const CRef cr = clausef_.New(k, as);
       Clause& c = clausef_[cr];
       if (c.valid()) {
-        clausef_.Delete(cr, as.size());
+        clausef_.Delete(cr, k);
       } else if (c.unsat()) {
         empty_clause_ = true;
-        clausef_.Delete(cr, as.size());
+        clausef_.Delete(cr, k);
       } else if (c.size() == 1) {
         AddLiteral(c[0]);
-        clausef_.Delete(cr, as.size());
+        clausef_.Delete(cr, k);
       } else {
         assert(c.size() >= 2);
         if (falsifies(c[0]) || falsifies(c[1])) {
@@ -166,25 +369,14 @@ class Sat {
       }
       clauses_.resize(i + 1);
     }
-    fun_bump_step_ = kBumpStepInit;
+    fun_queue_.ResetBumps();
     assert(Invariants());
   }
 
   template<typename ActivityFunction>
   void Reset(const KeepLearnt keep_learnt = {true}, ActivityFunction activity = ActivityFunction()) {
     Reset(keep_learnt);
-    for (const Fun f : fun_activity_->keys()) {
-      const Activity old_act = (*fun_activity_)[f];
-      const Activity new_act = activity(f);
-      (*fun_activity_)[f] = new_act;
-      if (fun_queue_.contains(f)) {
-        if (new_act > old_act) {
-          fun_queue_.Increase(f);
-        } else if (old_act > new_act) {
-          fun_queue_.Decrease(f);
-        }
-      }
-    }
+    fun_queue_.Reassign(activity);
   }
 
   void Simplify() {
@@ -225,12 +417,49 @@ class Sat {
     clauses_.resize(n_clauses);
   }
 
+  // Propagates the added clauses and literals at the base level, that is,
+  // independently of any decision, and appends the derived literals to units.
+  // Returns false iff propagation leads to a conflict.
+  bool PropagateBase(std::vector<Lit>* units) {
+    assert(current_level() == Level::kBase);
+    if (empty_clause_ || Propagate() != CRef::kNull) {
+      return false;
+    }
+    units->insert(units->end(), trail_.begin(), trail_.end());
+    return true;
+  }
+
   const std::vector<CRef>& clauses()       const { return clauses_; }
   const Clause&            clause(CRef cr) const { return clausef_[cr]; }
 
   int                       model_size() const { return trail_eqs_; }
   const TermMap<Fun, Name>& model()      const { return model_; }
 
+  // Tracked functions are counted in tracked_model_size() while they are
+  // assigned, which is maintained incrementally by Enqueue() and Backtrack().
+  void Track(const Fun f, const bool b = true) {
+    tracked_.FitForKey(f, false);
+    if (tracked_[f] != b) {
+      tracked_[f] = b;
+      const int d = b ? 1 : -1;
+      tracked_size_ += d;
+      if (model_.key_in_range(f) && !model_[f].null()) {
+        tracked_eqs_ += d;
+      }
+    }
+  }
+
+  void Untrack() {
+    tracked_.Clear();
+    tracked_size_ = 0;
+    tracked_eqs_ = 0;
+  }
+
+  bool tracked(const Fun f)   const { return tracked_.key_in_range(f) && tracked_[f]; }
+  int  tracked_size()         const { return tracked_size_; }
+  int  tracked_model_size()   const { return tracked_eqs_; }
+  bool tracked_all_assigned() const { return tracked_eqs_ == tracked_size_; }
+
   bool     propagate_with_learnt()       const { return propagate_with_learnt_; }
   void set_propagate_with_learnt(bool b)       { propagate_with_learnt_ = b; }
 
@@ -350,39 +579,11 @@ class Sat {
     CRef reason = CRef::kNull;    // clause which derived f = n or f != n
   };
 
-  class ActivityCompare {
-   public:
-    explicit ActivityCompare(const TermMap<Fun, Activity>* fa) : fa_(fa) {}
-    bool operator()(const Fun f1, const Fun f2) const { return (*fa_)[f1] > (*fa_)[f2]; }
-   private:
-    const TermMap<Fun, Activity>* fa_ = nullptr;
-  };
-
-
   static_assert(sizeof(FunNameData) == 4 + sizeof(CRef), "FunNameData should be 4 + 4 bytes");
 
-  static constexpr double kBumpStepInit   = 1.0;
-  static constexpr double kBumpMultiplier = 1.05;
-  static constexpr double kDecayThreshold = 1e100;
-
-
-  void Bump(const Fun f, const double bump) {
-    assert(bump >= 0);
-    (*fun_activity_)[f] += bump;
-    if ((*fun_activity_)[f] > kDecayThreshold) {
-      for (Activity& a : fun_activity_->values()) {
-        a /= kDecayThreshold;
-      }
-      fun_bump_step_ /= kDecayThreshold;
-    }
-    if (fun_queue_.contains(f)) {
-      fun_queue_.Increase(f);
-    }
-  }
-
-  void BumpToFront(const Fun f) { Bump(f, kDecayThreshold); }
-  void Bump(const Fun f)        { Bump(f, fun_bump_step_); }
-  void Decay()                  { fun_bump_step_ *= kBumpMultiplier; }
+  void BumpToFront(const Fun f) { fun_queue_.BumpToFront(f, !model_[f].null()); }
+  void Bump(const Fun f)        { fun_queue_.Bump(f, !model_[f].null()); }
+  void Decay()                  { fun_queue_.Decay(); }
 
   void Watch(const CRef cr, const Clause& c) {
     assert(&clausef_[cr] == &c);
@@ -515,8 +716,7 @@ class Sat {
   void Analyze(CRef conflict, const std::vector<Lit>& nogood, std::vector<Lit>* const learnt, Level* const btlevel) {
     assert(learnt->empty());
     assert(std::all_of(data_.values().begin(), data_.values().end(),
-                       [](const auto& ds) -> bool { return std::all_of(ds.values().begin(), ds.values().end(),
-                       [](const FunNameData& d) -> bool { return !d.seen_subsumed && !d.wanted; }); }));
+                       [](const FunNameData& d) -> bool { return !d.seen_subsumed && !d.wanted; }));
     int depth = 0;
     Lit trail_a = Lit();
     int trail_i = trail_.size() - 1;
@@ -698,12 +898,10 @@ class Sat {
     assert(level_of(trail_a) > *btlevel && *btlevel >= Level::kRoot);
     assert(std::all_of(learnt->begin(), learnt->end(), [this](Lit a) -> bool { return falsifies(a); }));
     assert(std::all_of(learnt->begin(), learnt->end(), [this](Lit a) -> bool { return !satisfies(a); }));
-    assert(std::all_of(data_.values().begin(), data_.values().end(), [](const auto& ds) -> bool {
-          return std::all_of(ds.values().begin(), ds.values().end(), [](const FunNameData& d) -> bool {
-              return !d.seen_subsumed; }); }));
-    assert(std::all_of(data_.values().begin(), data_.values().end(), [](const auto& ds) -> bool {
-          return std::all_of(ds.values().begin(), ds.values().end(), [](const FunNameData& d) -> bool {
-              return !d.wanted; }); }));
+    assert(std::all_of(data_.values().begin(), data_.values().end(),
+                       [](const FunNameData& d) -> bool { return !d.seen_subsumed; }));
+    assert(std::all_of(data_.values().begin(), data_.values().end(),
+                       [](const FunNameData& d) -> bool { return !d.wanted; }));
   }
 
   void AddNewLevel() { level_size_.push_back(trail_.size()); }
@@ -726,6 +924,7 @@ class Sat {
       model_[f] = n;
       data_[f][n].Update(FunNameData::kModelEq, current_level(), reason);
       ++trail_eqs_;
+      tracked_eqs_ += tracked(f);
     }
     assert(satisfies(a));
   }
@@ -763,9 +962,8 @@ class Sat {
       if (p) {
         model_[f] = Name();
         --trail_eqs_;
-        if (!fun_queue_.contains(f)) {
-          fun_queue_.Insert(f);
-        }
+        tracked_eqs_ -= tracked(f);
+        fun_queue_.Unassign(f);
       } else {
         --trail_neqs_[f];
       }
@@ -784,17 +982,7 @@ class Sat {
     assert(std::all_of(trail_.begin(), trail_.end(), [this](Lit a) { return satisfies(a); }));
   }
 
-  Fun NextFun() {
-    Fun f;
-    do {
-      f = fun_queue_.top();
-      if (f.null()) {
-        break;
-      }
-      fun_queue_.Remove(f);
-    } while (!model_[f].null());
-    return f;
-  }
+  Fun NextFun() { return fun_queue_.Next([this](const Fun f) { return !model_[f].null(); }); }
 
   Name NextName(const Fun f) {
     Name n = Name();
@@ -868,12 +1056,11 @@ class Sat {
 
   void FitMaps(const Fun f, const Name n) {
     const int fi = f.id() > data_.upper_bound_index() ? f.id() : -1;
-    const int ni = data_.empty() || n.id() > data_.head().upper_bound_index() ? n.id() : -1;
+    const int ni = n.id() > data_.upper_bound_col_index() ? n.id() : -1;
     const int fig = (fi + 1) * 1.5;
-    const int nig = ni >= 0 ? (ni + 1) * 3 / 2 : data_.head().upper_bound_index() + 1;
+    const int nig = (ni + 1) * 3 / 2;
     if (fi >= 0) {
       fun_queue_.FitForIndex(fig);
-      fun_activity_->FitForIndex(fig);
       domain_.FitForIndex(fig);
       domain_size_.FitForIndex(fig);
       watchers_.FitForIndex(fig);
@@ -881,15 +1068,8 @@ class Sat {
       data_.FitForIndex(fig);
       trail_neqs_.FitForIndex(fig);
     }
-    if (fi >= 0 || ni >= 0) {
-      for (TermMap<Name, FunNameData>& ds : data_.values()) {
-        ds.FitForIndex(nig);
-      }
-    }
     if (ni >= 0) {
-      for (TermMap<Name, FunNameData>& ds : data_.values()) {
-        ds.FitForIndex(nig);
-      }
+      data_.FitForColIndex(nig);
     }
   }
 
@@ -939,21 +1119,25 @@ class Sat {
   // model_ is an assignment of functions to names, i.e., positive literals.
   // data_ is meta data for every function and name pair (cf. FunNameData).
   TermMap<Fun, Name>                       model_{};
-  TermMap<Fun, TermMap<Name, FunNameData>> data_{};
+  TermMatrix<Fun, Name, FunNameData>       data_{};
 
-  // fun_activity_ assigns an activity to each function.
-  // fun_queue_ ranks the clauses by activity (highest first).
-  std::unique_ptr<TermMap<Fun, Activity>> fun_activity_{new TermMap<Fun, Activity>()};
-  MinHeap<Fun, ActivityCompare>           fun_queue_{ActivityCompare(fun_activity_.get())};
-  double                                  fun_bump_step_ = kBumpStepInit;
+  // tracked_ marks the functions counted by tracked_size_, and tracked_eqs_
+  //    is the number of those that are assigned in model_.
+  TermMap<Fun, bool> tracked_{};
+  int                tracked_size_ = 0;
+  int                tracked_eqs_  = 0;
+
+  // fun_queue_ decides which function is assigned next.
+  FunQueue<Activity> fun_queue_{};
 };
 
 #ifndef NDEBUG
-template<typename Activity>
-bool Sat<Activity>::Invariants(bool allow_inconsistency) const {
+template<typename Activity, template<typename> class FunQueue>
+bool Sat<Activity, FunQueue>::Invariants(bool allow_inconsistency) const {
   // Trail.
   assert(trail_head_ <= int(trail_.size()));
   int trail_eqs = 0;
+  int tracked_eqs = 0;
   TermMap<Fun, int> trail_neqs;
   trail_neqs.FitForIndex(trail_neqs_.upper_bound_index());
   for (const Lit a : trail_) {
@@ -962,12 +1146,14 @@ bool Sat<Activity>::Invariants(bool allow_inconsistency) const {
     if (a.pos()) {
       assert(model_[a.fun()] == a.name());
       ++trail_eqs;
+      tracked_eqs += tracked(a.fun());
     } else {
       assert(data_[a.fun()][a.name()].model_neq);
       ++trail_neqs[a.fun()];
     }
   }
   assert(trail_eqs == trail_eqs_);
+  assert(tracked_eqs == tracked_eqs_);
   for (Fun f : trail_neqs_.keys()) {
     assert(trail_neqs[f] == trail_neqs_[f]);
   }
@@ -1042,7 +1228,6 @@ bool Sat<Activity>::Invariants(bool allow_inconsistency) const {
     assert(occurs == 0 || !model_[f].null() || fun_queue_.contains(f));
     assert((occurs == 0 && trail_neqs_[f] == 0) || trail_neqs_[f] < occurs);
   }
-  assert(fun_bump_step_ >= 0.0);
   return true;
 }
 #endif
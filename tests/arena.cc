@@ -0,0 +1,54 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+
+#include <gtest/gtest.h>
+
+#include <limbo/internal/arena.h>
+
+namespace limbo {
+namespace internal {
+
+template<typename T>
+std::vector<T> vec(typename ArenaSet<T>::Range r) { return std::vector<T>(r.begin(), r.end()); }
+
+TEST(ArenaSetTest, general) {
+  ArenaSet<int> set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_EQ(set.Insert({1, 2, 3}), std::make_pair(0, true));
+  EXPECT_EQ(set.Insert({}), std::make_pair(1, true));
+  EXPECT_EQ(set.Insert({3, 2, 1}), std::make_pair(2, true));
+  EXPECT_EQ(set.Insert({1, 2, 3}), std::make_pair(0, false));
+  EXPECT_EQ(set.Insert({}), std::make_pair(1, false));
+  EXPECT_EQ(set.size(), 3);
+  EXPECT_EQ(vec<int>(set[0]), std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(vec<int>(set[1]), std::vector<int>());
+  EXPECT_EQ(vec<int>(set[2]), std::vector<int>({3, 2, 1}));
+  EXPECT_TRUE(set.contains({3, 2, 1}));
+  EXPECT_FALSE(set.contains({1, 2}));
+  int n = 0;
+  for (const ArenaSet<int>::Range r : set) {
+    EXPECT_EQ(vec<int>(r), vec<int>(set[n]));
+    ++n;
+  }
+  EXPECT_EQ(n, 3);
+  set.Clear();
+  EXPECT_TRUE(set.empty());
+  EXPECT_FALSE(set.contains({1, 2, 3}));
+}
+
+TEST(ArenaSetTest, rehash) {
+  ArenaSet<int> set;
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(set.Insert({i, i + 1}), std::make_pair(i, true));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(set.Insert({i, i + 1}), std::make_pair(i, false));
+    EXPECT_EQ(set.Find(set[i].begin(), set[i].end()), i);
+  }
+  EXPECT_EQ(set.size(), 1000);
+  EXPECT_FALSE(set.contains({1000, 1001}));
+}
+
+}  // namespace internal
+}  // namespace limbo
+
@@ -102,5 +102,32 @@ TEST(ClauseTest, ClauseFactory) {
   }
 }
 
+TEST(ClauseTest, FunSignature) {
+  Fun f = Fun::FromId(1);
+  Fun g = Fun::FromId(2);
+  Fun h = Fun::FromId(3);
+  Fun f64 = Fun::FromId(1 + 64);
+  Name m = Name::FromId(1);
+  Name n = Name::FromId(2);
+  Clause::Factory factory;
+
+  const Clause::Factory::CRef c = factory.New({Lit::Eq(f, m), Lit::Neq(g, n)});
+  const Clause::Factory::CRef d = factory.New({Lit::Neq(f, n), Lit::Neq(g, n), Lit::Eq(h, m)});
+  const Clause::Factory::CRef e = factory.New({Lit::Eq(f64, m), Lit::Neq(g, n)});
+  const Clause::Factory::CRef r = factory.New({Lit::Eq(f, m), Lit::Neq(h, n)});
+  const Clause::Factory::CRef v = factory.New(Lit());
+  EXPECT_EQ(factory[c].fun_signature(), Clause::FunSignature(Lit::Eq(f, m)) | Clause::FunSignature(Lit::Eq(g, m)));
+  EXPECT_EQ(factory[c].fun_signature(), factory[e].fun_signature());
+  EXPECT_TRUE(factory[c].Subsumes(factory[d]));
+  EXPECT_FALSE(factory[d].Subsumes(factory[c]));
+  // The signatures collide, so only the literals tell c and e apart.
+  EXPECT_FALSE(factory[e].Subsumes(factory[d]));
+  EXPECT_FALSE(factory[c].Subsumes(factory[e]));
+
+  factory[r].RemoveIf([h](Lit a) { return a.fun() == h; });
+  EXPECT_EQ(factory[r].fun_signature(), Clause::FunSignature(Lit::Eq(f, m)));
+  EXPECT_EQ(factory[v].fun_signature(), 0u);
+}
+
 }  // namespace limbo
  
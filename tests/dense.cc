@@ -1,6 +1,8 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2016 Christoph Schwering
 
+#include <functional>
+
 #include <gtest/gtest.h>
 
 #include <limbo/internal/dense.h>
@@ -58,6 +60,96 @@ TEST(DenseMapTest, general) {
   EXPECT_EQ(map[4], "four");
 }
 
+template<typename Value>
+using IntMatrix = DenseMatrix<int, int, Value, int, 0, To<int, int>, To<int, int>, To<int, int>, To<int, int>>;
+
+TEST(DenseMatrixTest, general) {
+  IntMatrix<int> m;
+  EXPECT_TRUE(m.empty());
+  m.FitForKey(2);
+  m[0].FitForKey(1);
+  EXPECT_EQ(length(m.keys()), 3u);
+  EXPECT_EQ(length(m[1].keys()), 2u);
+  for (int i : m.keys()) {
+    for (int j : m[i].keys()) {
+      EXPECT_EQ(m[i][j], 0);
+      m[i][j] = 10 * i + j;
+    }
+  }
+  m[2].FitForKey(9);
+  m.FitForKey(5);
+  EXPECT_EQ(m.upper_bound_key(), 5);
+  EXPECT_EQ(m[3].upper_bound_key(), 9);
+  for (int i : m.keys()) {
+    for (int j : m[i].keys()) {
+      EXPECT_EQ(m[i][j], i <= 2 && j <= 1 ? 10 * i + j : 0);
+    }
+  }
+  const IntMatrix<int> m2 = m;
+  EXPECT_EQ(m2[2][1], 21);
+  EXPECT_TRUE(m2[4].key_in_range(9));
+  EXPECT_FALSE(m2[4].key_in_range(10));
+}
+
+TEST(DenseMatrixTest, bits) {
+  IntMatrix<bool> m;
+  m.FitForKey(3);
+  m[0].FitForKey(99);
+  for (int i : m.keys()) {
+    EXPECT_FALSE(m[i].any());
+  }
+  m[1][70] = true;
+  m[2][0] = true;
+  m[2][63] = m[1][70];
+  EXPECT_FALSE(m[0].any());
+  EXPECT_TRUE(m[1].any());
+  EXPECT_TRUE(m[2].any());
+  EXPECT_FALSE(m[3].any());
+  m[0].FitForKey(200);
+  for (int i : m.keys()) {
+    for (int j : m[i].keys()) {
+      EXPECT_EQ(m[i][j], (i == 1 && j == 70) || (i == 2 && (j == 0 || j == 63)));
+    }
+  }
+  m[2][0] = false;
+  m[2][63] = false;
+  EXPECT_FALSE(m[2].any());
+}
+
+TEST(DenseDaryMinHeapTest, general) {
+  using Heap = DenseDaryMinHeap<int, double, std::greater<double>, 4, int, 0, To<int, int>, To<int, int>,
+                                SlowAdjustBoundCheck>;
+  Heap heap;
+  EXPECT_TRUE(heap.empty());
+  EXPECT_EQ(heap.top(), 0);
+  for (int i = 1; i <= 100; ++i) {
+    heap.Insert(i, (i * 37) % 101);
+  }
+  EXPECT_EQ(heap.size(), 100);
+  EXPECT_EQ(heap.top(), 30);  // 30 * 37 = 1110 = 100 mod 101
+  heap.Decrease(30, -1);
+  EXPECT_NE(heap.top(), 30);
+  heap.Increase(7, 1000);
+  EXPECT_EQ(heap.top(), 7);
+  EXPECT_EQ(heap.priority(7), 1000);
+  heap.Remove(50);
+  EXPECT_FALSE(heap.contains(50));
+  heap.TransformPriorities([](double& p) { p /= 2; });
+  EXPECT_EQ(heap.priority(7), 500);
+
+  double last = 1e9;
+  int n = 0;
+  while (!heap.empty()) {
+    const int x = heap.top();
+    EXPECT_LE(heap.priority(x), last);
+    last = heap.priority(x);
+    heap.Remove(x);
+    ++n;
+  }
+  EXPECT_EQ(n, 99);
+  EXPECT_EQ(last, -0.5);
+}
+
 }  // namespace internal
 }  // namespace limbo
 
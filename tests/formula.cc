@@ -3,7 +3,9 @@
 
 #include <gtest/gtest.h>
 
+#include <functional>
 #include <iostream>
+#include <thread>
 
 #include <limbo/formula.h>
 #include <limbo/io/input.h>
@@ -342,5 +344,515 @@ TEST(FormulaTest, Rectify) {
   }
 }
 
+TEST(FormulaTest, PushInwardsGround) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);         LIMBO_REG(x);
+  Abc::VarSymbol y = abc.CreateVar(s);         LIMBO_REG(y);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(s, 0);    LIMBO_REG(n);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+
+  {
+    F phi = F::Not(F::Or(F::Equals(fc(), nm()), F::Not(F::Equals(fc(), nn()))));
+    phi.PushInwards();
+    EXPECT_EQ(phi, F::And(F::NotEquals(fc(), nm()), F::Equals(fc(), nn())));
+  }
+
+  {
+    const std::vector<Name> names = {Name::FromId(1), Name::FromId(2)};
+    F phi = F::Exists(x, F::Forall(y, F::Equals(F::Var(x), F::Var(y))));
+    phi.Ground([&names](const Abc::Sort) -> const std::vector<Name>& { return names; });
+    auto eq = [&names](int i, int j) { return F::Equals(F::Name(names[i]), F::Name(names[j])); };
+    EXPECT_EQ(phi, F::Or(F::And(eq(0, 0), eq(0, 1)), F::And(eq(1, 0), eq(1, 1))));
+  }
+}
+
+// Equal up to a bijective renaming of variables.
+static bool AlphaEqual(const F& phi, const F& psi) {
+  Abc::DenseMap<Abc::VarSymbol, Abc::VarSymbol> to;
+  Abc::DenseMap<Abc::VarSymbol, Abc::VarSymbol> from;
+  if (phi.end() - phi.begin() != psi.end() - psi.begin()) {
+    return false;
+  }
+  for (auto it = phi.begin(), jt = psi.begin(); it != phi.end(); ++it, ++jt) {
+    if (it->tag != jt->tag) {
+      return false;
+    } else if (it->tag == Abc::Symbol::kVar || it->tag == Abc::Symbol::kExists || it->tag == Abc::Symbol::kForall) {
+      if (to[it->u.x].null() && from[jt->u.x].null()) {
+        to[it->u.x] = jt->u.x;
+        from[jt->u.x] = it->u.x;
+      }
+      if (to[it->u.x] != jt->u.x || from[jt->u.x] != it->u.x) {
+        return false;
+      }
+    } else if (!(*it == *jt)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Checks that Normalize() does the same as Rectify(), Flatten(), and
+// PushInwards().
+static bool NormalizesStepwise(const F& phi) {
+  F fused = phi.Clone();
+  fused.Normalize();
+  F stepwise = phi.Clone();
+  stepwise.Rectify();
+  stepwise.Flatten();
+  stepwise.PushInwards();
+  return AlphaEqual(fused, stepwise) && fused.readable().nnf();
+}
+
+TEST(FormulaTest, Normalize) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);         LIMBO_REG(x);
+  Abc::VarSymbol y = abc.CreateVar(s);         LIMBO_REG(y);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(s, 0);    LIMBO_REG(n);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol f = abc.CreateFun(s, 2);      LIMBO_REG(f);
+  Abc::FunSymbol g = abc.CreateFun(s, 1);      LIMBO_REG(g);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+  auto fun = [f](F&& t1, F&& t2) { std::list<F> args; args.push_back(std::move(t1)); args.push_back(std::move(t2)); return F::Fun(f, std::move(args)); };
+  auto gun = [g](F&& t) { std::list<F> args; args.push_back(std::move(t)); return F::Fun(g, std::move(args)); };
+  std::vector<F> phis;
+  phis.push_back(F::Exists(x, F::Or(F::Forall(y, F::Equals(fun(F::Var(x), F::Var(y)), gun(F::Var(y)))),
+                                    F::Exists(x, F::Not(F::Equals(gun(gun(F::Var(x))), nm()))))));
+  phis.push_back(F::Not(F::And(F::Or(F::Equals(fc(), nm()), F::Not(F::Equals(fc(), nn()))),
+                               F::Forall(x, F::Or(F::NotEquals(gun(fc()), F::Var(x)), F::Equals(F::Var(x), nn()))))));
+  phis.push_back(F::Know(1, F::Not(F::Exists(x, F::And(F::Equals(gun(F::Var(x)), F::Var(x)),
+                                                       F::Not(F::Exists(x, F::Equals(fun(fc(), F::Var(x)), nm()))))))));
+  phis.push_back(F::Not(F::Action(gun(fc()), F::Or(F::Action(nm(), F::Not(F::Equals(fun(fc(), nn()), nm()))),
+                                                    F::Maybe(0, F::Not(F::Equals(gun(nn()), nm())))))));
+  phis.push_back(F::Forall(x, F::Action(F::Var(x), F::Exists(y, F::Not(F::Action(gun(F::Var(y)),
+                                                                                 F::Equals(gun(F::Var(x)), F::Var(y))))))));
+  for (const F& phi : phis) {
+    EXPECT_TRUE(NormalizesStepwise(phi));
+  }
+}
+
+TEST(FormulaTest, NormalizeSystematic) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);         LIMBO_REG(x);
+  Abc::VarSymbol y = abc.CreateVar(s);         LIMBO_REG(y);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(s, 0);    LIMBO_REG(n);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol f = abc.CreateFun(s, 2);      LIMBO_REG(f);
+  Abc::FunSymbol g = abc.CreateFun(s, 1);      LIMBO_REG(g);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+  auto fun = [f](F&& t1, F&& t2) { std::list<F> args; args.push_back(std::move(t1)); args.push_back(std::move(t2)); return F::Fun(f, std::move(args)); };
+  auto gun = [g](F&& t) { std::list<F> args; args.push_back(std::move(t)); return F::Fun(g, std::move(args)); };
+
+  // Literals with nested terms and free variables, which become bound or
+  // shadowed by the quantifiers below.
+  std::vector<F> leaves;
+  leaves.push_back(F::Equals(gun(F::Var(x)), F::Var(y)));
+  leaves.push_back(F::NotEquals(fun(F::Var(y), gun(fc())), nm()));
+  leaves.push_back(F::Equals(fc(), nn()));
+  leaves.push_back(F::Equals(F::Var(x), gun(gun(F::Var(x)))));
+  std::vector<std::function<F(const F&)>> unary;
+  unary.push_back([](const F& phi) { return F::Not(phi); });
+  unary.push_back([x](const F& phi) { return F::Exists(x, phi); });
+  unary.push_back([x](const F& phi) { return F::Forall(x, phi); });
+  unary.push_back([y](const F& phi) { return F::Exists(y, phi); });
+  unary.push_back([y](const F& phi) { return F::Forall(y, phi); });
+  unary.push_back([x, &gun](const F& phi) { return F::Action(gun(F::Var(x)), phi); });
+  unary.push_back([&nm](const F& phi) { return F::Action(nm(), phi); });
+  unary.push_back([](const F& phi) { return F::Know(0, phi); });
+  unary.push_back([](const F& phi) { return F::Maybe(1, phi); });
+  std::vector<std::function<F(const F&, const F&)>> binary;
+  binary.push_back([](const F& phi, const F& psi) { return F::And(phi, psi); });
+  binary.push_back([](const F& phi, const F& psi) { return F::Or(phi, psi); });
+  binary.push_back([](const F& phi, const F& psi) { return F::Believe(0, 1, phi, psi); });
+
+  // All leaves under up to three unary operators.
+  std::vector<std::vector<F>> by_depth(4);
+  by_depth[0] = std::move(leaves);
+  for (int d = 1; d < int(by_depth.size()); ++d) {
+    for (const F& phi : by_depth[d - 1]) {
+      for (const auto& u : unary) {
+        by_depth[d].push_back(u(phi));
+      }
+    }
+  }
+  int n_checked = 0;
+  for (const std::vector<F>& phis : by_depth) {
+    for (const F& phi : phis) {
+      EXPECT_TRUE(NormalizesStepwise(phi));
+      ++n_checked;
+    }
+  }
+
+  // All pairs of leaves, or the first leaf under one unary operator, joined
+  // by a binary operator, which is itself under up to one of a negation,
+  // quantifier, or action.
+  std::vector<F> operands;
+  for (const F& phi : by_depth[0]) {
+    operands.push_back(phi.Clone());
+  }
+  for (size_t i = 0; i < unary.size(); ++i) {
+    operands.push_back(by_depth[1][i].Clone());
+  }
+  std::vector<std::function<F(const F&)>> outer;
+  outer.push_back([](const F& phi) { return phi.Clone(); });
+  outer.push_back(unary[0]);
+  outer.push_back(unary[2]);
+  outer.push_back(unary[5]);
+  for (const F& phi : operands) {
+    for (const F& psi : operands) {
+      for (const auto& b : binary) {
+        const F xi = b(phi, psi);
+        for (const auto& o : outer) {
+          EXPECT_TRUE(NormalizesStepwise(o(xi)));
+          ++n_checked;
+        }
+      }
+    }
+  }
+  EXPECT_EQ(n_checked, 4 * (1 + 9 + 81 + 729) + 13 * 13 * 3 * 4);
+}
+
+TEST(FormulaTest, Simplify) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);         LIMBO_REG(x);
+  Abc::VarSymbol y = abc.CreateVar(s);         LIMBO_REG(y);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(s, 0);    LIMBO_REG(n);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol d = abc.CreateFun(s, 0);      LIMBO_REG(d);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto fd = [d]() { return F::Fun(d, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+  auto simplified = [](F&& phi) { phi.Simplify(); return std::move(phi); };
+  const F truth = F::And(std::list<F>{});
+  const F falsity = F::Or(std::list<F>{});
+
+  EXPECT_EQ(simplified(F::Equals(nm(), nm())), truth);
+  EXPECT_EQ(simplified(F::Equals(nm(), nn())), falsity);
+  EXPECT_EQ(simplified(F::NotEquals(nm(), nn())), truth);
+  EXPECT_EQ(simplified(F::Equals(fc(), fc())), truth);
+  EXPECT_EQ(simplified(F::Equals(fc(), nm())), F::Equals(fc(), nm()));
+  EXPECT_EQ(simplified(F::Not(F::Equals(F::Var(x), F::Var(x)))), falsity);
+  EXPECT_EQ(simplified(F::Or(F::Equals(fc(), nm()), F::Equals(nm(), nn()))), F::Equals(fc(), nm()));
+  EXPECT_EQ(simplified(F::And(F::Equals(fc(), nm()), F::Equals(nm(), nn()))), falsity);
+  EXPECT_EQ(simplified(F::Forall(x, F::Or(F::Equals(fc(), nm()), F::Equals(fd(), nn())))),
+            F::Or(F::Equals(fc(), nm()), F::Equals(fd(), nn())));
+  EXPECT_EQ(simplified(F::Exists(x, F::Equals(fc(), F::Var(x)))), F::Exists(x, F::Equals(fc(), F::Var(x))));
+  EXPECT_EQ(simplified(F::Action(nm(), F::Equals(fc(), fc()))), truth);
+
+  // idempotence and merging
+  EXPECT_EQ(simplified(F::Or(F::Equals(fc(), nm()), F::Or(F::Equals(fd(), nn()), F::Equals(fc(), nm())))),
+            F::Or(F::Equals(fc(), nm()), F::Equals(fd(), nn())));
+  // absorption
+  EXPECT_EQ(simplified(F::And(F::Or(F::Equals(fc(), nm()), F::Equals(fd(), nn())), F::Equals(fd(), nn()))),
+            F::Equals(fd(), nn()));
+  EXPECT_EQ(simplified(F::Or(F::And(F::Equals(fc(), nm()), F::Equals(fd(), nn())),
+                             F::And(F::Equals(fd(), nn()), F::Equals(fc(), nm())))),
+            F::And(F::Equals(fc(), nm()), F::Equals(fd(), nn())));
+
+  {
+    const std::vector<Name> names = {Name::FromId(1), Name::FromId(2), Name::FromId(3)};
+    auto sort_names = [&names](const Abc::Sort) -> const std::vector<Name>& { return names; };
+    F phi = F::Forall(x, F::Forall(y, F::Or(F::Equals(F::Var(x), F::Var(x)), F::Equals(fc(), F::Var(y)))));
+    F psi = phi.Clone();
+    phi.Ground(sort_names);
+    psi.Simplify();
+    psi.Ground(sort_names);
+    EXPECT_EQ(psi, truth);
+    EXPECT_GT(phi.end() - phi.begin(), 10);
+  }
+}
+
+TEST(FormulaTest, Progress) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::Sort a = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(a);         LIMBO_REG(x);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(a, 0);    LIMBO_REG(n);
+  Abc::NameSymbol o = abc.CreateName(a, 0);    LIMBO_REG(o);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol d = abc.CreateFun(s, 0);      LIMBO_REG(d);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto fd = [d]() { return F::Fun(d, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+  auto no = [o]() { return F::Name(o, std::list<F>{}); };
+  auto normalized = [](F&& phi) { phi.Normalize(); phi.Simplify(); return std::move(phi); };
+
+  {
+    F phi = normalized(F::And(F::Action(nn(), F::Equals(fc(), nm())), F::Equals(fd(), nm())));
+    EXPECT_TRUE(phi.Progress(nn()));
+    EXPECT_EQ(phi, normalized(F::Equals(fc(), nm())));
+    EXPECT_FALSE(phi.readable().dynamic());
+  }
+
+  {
+    F phi = normalized(F::Or(F::Action(no(), F::Equals(fc(), nm())), F::Equals(fd(), nm())));
+    EXPECT_FALSE(phi.Progress(nn()));
+  }
+
+  {
+    F phi = normalized(F::Action(nn(), F::Action(no(), F::Equals(fc(), nm()))));
+    EXPECT_TRUE(phi.Progress(nn()));
+    EXPECT_EQ(phi, normalized(F::Action(no(), F::Equals(fc(), nm()))));
+    EXPECT_TRUE(phi.Progress(no()));
+    EXPECT_EQ(phi, normalized(F::Equals(fc(), nm())));
+    EXPECT_FALSE(phi.Progress(nn()));
+  }
+
+  {
+    auto name = [](const Abc::NameSymbol k) { F t = F::Name(k); t.Strip(); return t.head().u.n_s; };
+    const std::vector<Name> names = {name(n), name(o)};
+    F phi = normalized(F::Forall(x, F::Action(F::Var(x), F::Equals(fc(), nm()))));
+    F t = nn();
+    t.Strip();
+    EXPECT_TRUE(phi.Progress(t));
+    phi.Strip();
+    phi.Ground([&names](const Abc::Sort) -> const std::vector<Name>& { return names; });
+    phi.Simplify();
+    F psi = normalized(F::Equals(fc(), nm()));
+    psi.Strip();
+    EXPECT_EQ(phi, psi);
+  }
+
+  {
+    // Actions are compared up to stripping.
+    F t = nn();
+    t.Strip();
+    F phi = normalized(F::Action(nn(), F::Equals(fc(), nm())));
+    EXPECT_TRUE(phi.Progress(t));
+    EXPECT_EQ(phi, normalized(F::Equals(fc(), nm())));
+    F psi = normalized(F::Action(nn(), F::Equals(fc(), nm())));
+    psi.Strip();
+    EXPECT_TRUE(psi.Progress(nn()));
+    F xi = normalized(F::Equals(fc(), nm()));
+    xi.Strip();
+    EXPECT_EQ(psi, xi);
+  }
+
+  {
+    // The progressed KB stays flat over many actions.
+    std::vector<F> kb;
+    for (int i = 0; i < 100; ++i) {
+      kb.push_back(normalized(F::Action(nn(), F::Equals(fc(), nm()))));
+      kb.push_back(normalized(F::Action(no(), F::Equals(fd(), nm()))));
+      F::Progress(&kb, nn());
+      ASSERT_EQ(kb.size(), 1u);
+      EXPECT_EQ(kb[0], normalized(F::Equals(fc(), nm())));
+    }
+  }
+}
+
+TEST(FormulaTest, Squaring) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::Sort a = abc.CreateSort(false);
+  Abc::NameSymbol m = abc.CreateName(s, 0);    LIMBO_REG(m);
+  Abc::NameSymbol n = abc.CreateName(a, 0);    LIMBO_REG(n);
+  Abc::NameSymbol o = abc.CreateName(a, 0);    LIMBO_REG(o);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol d = abc.CreateFun(s, 0);      LIMBO_REG(d);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto fd = [d]() { return F::Fun(d, std::list<F>{}); };
+  auto nm = [m]() { return F::Name(m, std::list<F>{}); };
+  auto nn = [n]() { return F::Name(n, std::list<F>{}); };
+  auto no = [o]() { return F::Name(o, std::list<F>{}); };
+
+  {
+    const F tn = nn();
+    const F to = no();
+    const Abc::ActionSeq z1 = abc.Extend(Abc::ActionSeq(), Abc::RWord(tn.begin(), tn.end()));
+    const Abc::ActionSeq z2 = abc.Extend(z1, Abc::RWord(to.begin(), to.end()));
+    const F tn2 = nn();
+    EXPECT_EQ(abc.Extend(Abc::ActionSeq(), Abc::RWord(tn2.begin(), tn2.end())), z1);
+    EXPECT_EQ(abc.Extend(z1, Abc::RWord(to.begin(), to.end())), z2);
+    EXPECT_NE(abc.Extend(Abc::ActionSeq(), Abc::RWord(to.begin(), to.end())), z1);
+    EXPECT_NE(abc.Extend(z2, Abc::RWord(tn.begin(), tn.end())), z1);
+    EXPECT_EQ(z2.prefix(), z1);
+    EXPECT_EQ(z2.length(), 2);
+    const Abc::RWord w = abc.Squaring(z2, c);
+    EXPECT_EQ(w.begin(), abc.Squaring(z2, c).begin());
+    const Abc::Symbol::List ws(w.begin(), w.end());
+    EXPECT_EQ(ws, Abc::Symbol::List({Abc::Symbol::Fun(abc.Squaring(2, c)),
+                                     Abc::Symbol::Name(n),
+                                     Abc::Symbol::Name(o)}));
+  }
+
+  {
+    F phi = F::Action(nn(), F::And(F::Action(no(), F::Equals(fc(), nm())), F::Action(no(), F::Equals(fd(), nm()))));
+    phi.Squaring();
+    const Abc::FunSymbol c2 = abc.Squaring(2, c);
+    const Abc::FunSymbol d2 = abc.Squaring(2, d);
+    auto sq = [&](Abc::FunSymbol f) {
+      std::list<F> ts;
+      ts.push_back(nn());
+      ts.push_back(no());
+      return F::Fun(f, std::move(ts));
+    };
+    EXPECT_EQ(phi, F::And(F::Equals(sq(c2), nm()), F::Equals(sq(d2), nm())));
+  }
+}
+
+TEST(FormulaTest, Args) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);         LIMBO_REG(x);
+  Abc::FunSymbol c = abc.CreateFun(s, 0);      LIMBO_REG(c);
+  Abc::FunSymbol f = abc.CreateFun(s, 1);      LIMBO_REG(f);
+  auto fc = [c]() { return F::Fun(c, std::list<F>{}); };
+  auto ff = [f](F&& t) { std::list<F> ts; ts.push_back(std::move(t)); return F::Fun(f, std::move(ts)); };
+  auto disjunct = [&](int i) {
+    F t = fc();
+    for (int j = 0; j < i; ++j) {
+      t = ff(std::move(t));
+    }
+    return F::Exists(x, F::Equals(std::move(t), F::Var(x)));
+  };
+
+  std::list<F> disjuncts;
+  for (int i = 0; i < 9; ++i) {
+    disjuncts.push_back(disjunct(i));
+  }
+  const F phi = F::Not(F::Or(std::move(disjuncts)));
+  const RFormula r = phi.readable();
+  EXPECT_EQ(r.arity(), 1);
+  EXPECT_EQ(r.arg(0).arity(), 9);
+  for (int i = 8; i >= 0; --i) {
+    EXPECT_EQ(F(r.arg(0).arg(i)), disjunct(i));
+    EXPECT_EQ(F(r.arg(0).arg(i).arg(0).arg(0)), F(RFormula(r.arg(0).arg(i).arg(0).arg(0).begin())));
+  }
+  EXPECT_EQ(F(RFormula(phi.word().readable())), phi);
+  EXPECT_EQ(r.arg(0).args().size(), 9u);
+  EXPECT_EQ(r.arg(0).args().back().end(), phi.end());
+}
+
+TEST(FormulaTest, StripTerms) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::FunSymbol f = abc.CreateFun(s, 2);
+  std::vector<Abc::NameSymbol> ns;
+  for (int i = 0; i < 60; ++i) {
+    ns.push_back(abc.CreateName(s, 0));
+  }
+  auto strip = [f, &ns](int i, int j) {
+    std::list<F> args;
+    args.push_back(F::Name(ns[i]));
+    args.push_back(F::Name(ns[j]));
+    F t = F::Fun(f, std::move(args));
+    t.Strip();
+    return t.head();
+  };
+  EXPECT_FALSE(strip(0, 1) == strip(1, 0));
+  EXPECT_FALSE(strip(0, 0) == strip(1, 1));
+  std::vector<Abc::Symbol> stripped;
+  for (int i = 0; i < 60; ++i) {
+    for (int j = 0; j < 60; ++j) {
+      stripped.push_back(strip(i, j));
+    }
+  }
+  for (int i = 0; i < 60; ++i) {
+    for (int j = 0; j < 60; ++j) {
+      const Abc::Symbol sym = stripped[i * 60 + j];
+      EXPECT_EQ(strip(i, j), sym);
+      const Abc::RWord w = abc.Unstrip(sym);
+      ASSERT_EQ(w.end() - w.begin(), 3);
+      EXPECT_EQ(abc.Unstrip(*std::next(w.begin())).begin()->u.n, ns[i]);
+      EXPECT_EQ(abc.Unstrip(*std::next(w.begin(), 2)).begin()->u.n, ns[j]);
+    }
+  }
+}
+
+TEST(FormulaTest, StripNestedTerms) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::NameSymbol n = abc.CreateName(s, 0);
+  Abc::FunSymbol f = abc.CreateFun(s, 1);
+  Abc::FunSymbol g = abc.CreateFun(s, 1);
+  auto arg = [](Formula&& f1) { std::list<F> args; args.emplace_back(std::move(f1)); return args; };
+  {
+    // g(n) is primitive and stripped, f(g(n)) is not and stays unstripped.
+    F t = F::Fun(f, arg(F::Fun(g, arg(F::Name(n)))));
+    t.Strip();
+    EXPECT_EQ(t.head().tag, Abc::Symbol::kFun);
+    ASSERT_EQ(t.readable().arity(), 1);
+    EXPECT_EQ(t.readable().arg(0).head().tag, Abc::Symbol::kStrippedFun);
+    EXPECT_FALSE(t.readable().stripped());
+  }
+  {
+    // Hence f(g(n)) = n does not become a Lit.
+    F phi = F::Equals(F::Fun(f, arg(F::Fun(g, arg(F::Name(n))))), F::Name(n));
+    phi.Strip();
+    EXPECT_EQ(phi.head().tag, Abc::Symbol::kEquals);
+    EXPECT_EQ(phi.readable().arg(0).head().tag, Abc::Symbol::kFun);
+    EXPECT_EQ(phi.readable().arg(1).head().tag, Abc::Symbol::kStrippedName);
+  }
+  {
+    // After Flatten() and Ground(), everything is stripped.
+    F nn = F::Name(n);
+    nn.Strip();
+    const std::vector<Name> names = {nn.head().u.n_s};
+    F phi = F::Equals(F::Fun(f, arg(F::Fun(g, arg(F::Name(n))))), F::Name(n));
+    phi.Flatten();
+    phi.Ground([&names](const Abc::Sort) -> const std::vector<Name>& { return names; });
+    phi.Strip();
+    EXPECT_TRUE(phi.readable().stripped());
+  }
+}
+
+TEST(FormulaTest, ConcurrentStrip) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::FunSymbol f = abc.CreateFun(s, 1);
+  std::vector<Abc::NameSymbol> ns;
+  for (int i = 0; i < 100; ++i) {
+    ns.push_back(abc.CreateName(s, 0));
+  }
+  auto term = [f, &ns](int i) { std::list<F> args; args.push_back(F::Name(ns[i])); return F::Fun(f, std::move(args)); };
+
+  abc.set_concurrent(true);
+  std::vector<std::vector<Abc::Symbol>> stripped(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < int(stripped.size()); ++t) {
+    threads.emplace_back([t, &term, &stripped]() {
+      for (int i = 0; i < 100; ++i) {
+        F ft = term((i + 25 * t) % 100);
+        ft.Strip();
+        stripped[t].push_back(ft.head());
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  abc.set_concurrent(false);
+
+  for (int t = 0; t < int(stripped.size()); ++t) {
+    for (int i = 0; i < 100; ++i) {
+      const Abc::Symbol& sym = stripped[t][i];
+      EXPECT_EQ(sym, stripped[0][(i + 25 * t) % 100]);
+      EXPECT_TRUE(sym.tag == Abc::Symbol::kStrippedFun);
+      const Abc::RWord w = abc.Unstrip(sym);
+      EXPECT_EQ(w.end() - w.begin(), 2);
+      EXPECT_TRUE(*w.begin() == Abc::Symbol::Fun(f));
+      EXPECT_EQ(sym.sort(), s);
+    }
+  }
+}
+
 }  // namespace limbo
 
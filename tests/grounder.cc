@@ -0,0 +1,259 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2019 Christoph Schwering
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+#include <limbo/grounder.h>
+#include <limbo/limsat.h>
+#include <limbo/io/output.h>
+
+namespace limbo {
+
+using Abc = Alphabet;
+using F = Formula;
+
+static std::vector<std::vector<Lit>> Sorted(std::vector<std::vector<Lit>> cs) {
+  for (std::vector<Lit>& c : cs) {
+    std::sort(c.begin(), c.end());
+  }
+  std::sort(cs.begin(), cs.end());
+  cs.erase(std::unique(cs.begin(), cs.end()), cs.end());
+  return cs;
+}
+
+TEST(GrounderTest, Dag) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);
+  Abc::VarSymbol y = abc.CreateVar(s);
+  Abc::VarSymbol z = abc.CreateVar(s);
+  Abc::FunSymbol f = abc.CreateFun(s, 2);
+  Abc::FunSymbol g = abc.CreateFun(s, 2);
+  Abc::NameSymbol m = abc.CreateName(s, 0);
+  std::vector<Name> names;
+  for (int i = 0; i < 5; ++i) {
+    F n = F::Name(abc.CreateName(s, 0));
+    n.Strip();
+    names.push_back(n.head().u.n_s);
+  }
+  auto sort_names = [&names](const Abc::Sort) -> const std::vector<Name>& { return names; };
+  auto fun = [](Abc::FunSymbol h, Abc::VarSymbol x1, Abc::VarSymbol x2) {
+    std::list<F> args;
+    args.push_back(F::Var(x1));
+    args.push_back(F::Var(x2));
+    return F::Fun(h, std::move(args));
+  };
+
+  // fa x fa y fa z (f(x,y) = m v g(y,z) != m)
+  const F phi = F::Forall(x, F::Forall(y, F::Forall(z,
+      F::Or(F::Equals(fun(f, x, y), F::Name(m)), F::NotEquals(fun(g, y, z), F::Name(m))))));
+
+  F tree = phi.Clone();
+  tree.Ground(sort_names);
+  tree.Strip();
+
+  Grounder grounder;
+  const Grounder::node_t root = grounder.Ground(phi.readable(), sort_names);
+  EXPECT_EQ(grounder.Expand(root), tree);
+
+  std::vector<std::vector<Lit>> cs;
+  EXPECT_TRUE(grounder.Clauses(root, [&cs](const std::vector<Lit>& c) { cs.push_back(c); }));
+  EXPECT_EQ(cs.size(), 5u * 5u * 5u);
+  EXPECT_EQ(Sorted(cs), Sorted(tree.readable().CnfClauses().val));
+
+  EXPECT_EQ(grounder.Ground(phi.readable(), sort_names), root);
+
+  // fa x fa y fa z f(x,x) = m shares the body for all y and z
+  const F chi = F::Forall(x, F::Forall(y, F::Forall(z, F::Equals(fun(f, x, x), F::Name(m)))));
+  const int size = grounder.size();
+  const Grounder::node_t chi_root = grounder.Ground(chi.readable(), sort_names);
+  EXPECT_LE(grounder.size() - size, 5 * 5);
+  EXPECT_EQ(grounder.Expand(chi_root).word().size(), 1 + 5 + 5 * 5 + 5 * 5 * 5);
+  cs.clear();
+  EXPECT_TRUE(grounder.Clauses(chi_root, [&cs](const std::vector<Lit>& c) { cs.push_back(c); }));
+  EXPECT_EQ(cs.size(), 5u);
+
+  // ex x (f(x,x) = m ^ g(x,x) = m) is not a conjunction of clauses
+  const F psi = F::Exists(x, F::And(F::Equals(fun(f, x, x), F::Name(m)), F::Equals(fun(g, x, x), F::Name(m))));
+  cs.clear();
+  EXPECT_FALSE(grounder.Clauses(grounder.Ground(psi.readable(), sort_names),
+                                [&cs](const std::vector<Lit>& c) { cs.push_back(c); }));
+  EXPECT_TRUE(cs.empty());
+}
+
+TEST(GrounderTest, Stream) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  Abc::VarSymbol x = abc.CreateVar(s);
+  Abc::VarSymbol y = abc.CreateVar(s);
+  Abc::FunSymbol f = abc.CreateFun(s, 1);
+  Abc::NameSymbol m = abc.CreateName(s, 0);
+  std::vector<Name> names;
+  for (int i = 0; i < 4; ++i) {
+    F n = F::Name(abc.CreateName(s, 0));
+    n.Strip();
+    names.push_back(n.head().u.n_s);
+  }
+  auto sort_names = [&names](const Abc::Sort) -> const std::vector<Name>& { return names; };
+  auto fun = [](Abc::FunSymbol h, Abc::VarSymbol x1) {
+    std::list<F> args;
+    args.push_back(F::Var(x1));
+    return F::Fun(h, std::move(args));
+  };
+  auto sink = [](std::vector<std::vector<Lit>>* cs) { return [cs](const std::vector<Lit>& c) { cs->push_back(c); }; };
+
+  // fa x ((f(x) = m v x = m) ^ fa y (f(y) != x v x = y))
+  F phi = F::Forall(x, F::And(F::Or(F::Equals(fun(f, x), F::Name(m)), F::Equals(F::Var(x), F::Name(m))),
+                              F::Forall(y, F::Or(F::NotEquals(fun(f, y), F::Var(x)), F::Equals(F::Var(x), F::Var(y))))));
+  phi.Normalize();
+
+  std::vector<std::vector<Lit>> streamed;
+  EXPECT_TRUE(Grounder::StreamClauses(phi.readable(), sort_names, sink(&streamed)));
+  EXPECT_EQ(streamed.size(), 4u * 4u + 4u * 3u);
+  EXPECT_EQ(Sorted(streamed).size(), 4u + 4u * 3u);
+
+  Grounder grounder;
+  std::vector<std::vector<Lit>> dag;
+  EXPECT_TRUE(grounder.Clauses(grounder.Ground(phi.readable(), sort_names), sink(&dag)));
+  EXPECT_EQ(Sorted(streamed), Sorted(dag));
+
+  F tree = phi.Clone();
+  tree.Ground(sort_names);
+  tree.Strip();
+  EXPECT_EQ(Sorted(streamed), Sorted(tree.readable().CnfClauses().val));
+
+  // fa x ex y f(x) = y
+  const F chi = F::Forall(x, F::Exists(y, F::Equals(fun(f, x), F::Var(y))));
+  streamed.clear();
+  EXPECT_TRUE(Grounder::StreamClauses(chi.readable(), sort_names, sink(&streamed)));
+  EXPECT_EQ(streamed.size(), 4u);
+  for (const std::vector<Lit>& c : streamed) {
+    EXPECT_EQ(c.size(), 4u);
+  }
+
+  // fa x ex y (f(x) = y ^ f(y) = x) is not a conjunction of clauses
+  const F psi = F::Forall(x, F::Exists(y, F::And(F::Equals(fun(f, x), F::Var(y)), F::Equals(fun(f, y), F::Var(x)))));
+  streamed.clear();
+  EXPECT_FALSE(Grounder::StreamClauses(psi.readable(), sort_names, sink(&streamed)));
+  EXPECT_TRUE(streamed.empty());
+
+  // f(x) = m with free x cannot be grounded
+  EXPECT_FALSE(Grounder::StreamClauses(F::Equals(fun(f, x), F::Name(m)).readable(), sort_names, sink(&streamed)));
+}
+
+static bool Eval(const RFormula& f, const TermMap<Fun, Name>& model) {
+  switch (f.tag()) {
+    case Abc::Symbol::kStrippedLit: return f.head().u.a.pos() == (model[f.head().u.a.fun()] == f.head().u.a.name());
+    case Abc::Symbol::kNot:         return !Eval(f.arg(0), model);
+    case Abc::Symbol::kOr:          return std::any_of(f.args().begin(), f.args().end(), [&](const RFormula& g) { return Eval(g, model); });
+    case Abc::Symbol::kAnd:         return std::all_of(f.args().begin(), f.args().end(), [&](const RFormula& g) { return Eval(g, model); });
+    default:                        std::abort();
+  }
+}
+
+TEST(GrounderTest, Definitional) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  auto fun = [&abc, s]() { F f = F::Fun(abc.CreateFun(s, 0)); f.Strip(); return f.head().u.f_s; };
+  auto name = [&abc, s]() { F n = F::Name(abc.CreateName(s, 0)); n.Strip(); return n.head().u.n_s; };
+  const Name n1 = name();
+  const Name n2 = name();
+  std::vector<Fun> fs;
+  for (int i = 0; i < 6; ++i) {
+    fs.push_back(fun());
+  }
+  auto lit = [&fs, n1](int i) { return F::Lit(Lit::Eq(fs[i], n1)); };
+
+  // ((a ^ b) v (c ^ d) v ~(e v f)) ^ ((a ^ b) v e)
+  std::vector<F> disjuncts;
+  disjuncts.push_back(F::And(lit(0), lit(1)));
+  disjuncts.push_back(F::And(lit(2), lit(3)));
+  disjuncts.push_back(F::Not(F::Or(lit(4), lit(5))));
+  const F phi = F::And(F::Or(std::move(disjuncts)), F::Or(F::And(lit(0), lit(1)), lit(4)));
+  EXPECT_FALSE(phi.readable().CnfClauses());
+
+  Grounder grounder;
+  grounder.set_max_distributed(1);
+  std::vector<std::vector<Lit>> cs;
+  const Grounder::node_t root = grounder.Ground(phi.readable(), [](const Abc::Sort) { return std::vector<Name>(); });
+  EXPECT_TRUE(grounder.DefinitionalClauses(root, [&cs](const std::vector<Lit>& c) { cs.push_back(c); }));
+  EXPECT_EQ(cs.size(), 2u + 2u + 2u + 2u);
+
+  std::vector<Fun> aux;
+  Name t;
+  for (const std::vector<Lit>& c : cs) {
+    for (const Lit a : c) {
+      if (std::find(fs.begin(), fs.end(), a.fun()) == fs.end() && std::find(aux.begin(), aux.end(), a.fun()) == aux.end()) {
+        aux.push_back(a.fun());
+        t = a.name();
+      }
+    }
+  }
+  EXPECT_EQ(aux.size(), 3u);
+
+  for (int i = 0; i < (1 << fs.size()); ++i) {
+    TermMap<Fun, Name> model;
+    for (int j = 0; j < int(fs.size()); ++j) {
+      model.FitForKey(fs[j]);
+      model[fs[j]] = (i & (1 << j)) ? n1 : n2;
+    }
+    bool satisfiable = false;
+    for (int k = 0; k < (1 << aux.size()) && !satisfiable; ++k) {
+      for (int j = 0; j < int(aux.size()); ++j) {
+        model.FitForKey(aux[j]);
+        model[aux[j]] = (k & (1 << j)) ? t : n2;
+      }
+      satisfiable = std::all_of(cs.begin(), cs.end(), [&model](const std::vector<Lit>& c) {
+        return std::any_of(c.begin(), c.end(), [&model](const Lit a) { return a.pos() == (model[a.fun()] == a.name()); });
+      });
+    }
+    EXPECT_EQ(satisfiable, Eval(phi.readable(), model));
+  }
+}
+
+TEST(GrounderTest, DefinitionalBeliefLevel) {
+  Alphabet& abc = Alphabet::instance();
+  Abc::Sort s = abc.CreateSort(false);
+  auto fun = [&abc, s]() { F f = F::Fun(abc.CreateFun(s, 0)); f.Strip(); return f.head().u.f_s; };
+  auto name = [&abc, s]() { F n = F::Name(abc.CreateName(s, 0)); n.Strip(); return n.head().u.n_s; };
+  const Name n1 = name();
+  const Fun a = fun();
+  const Fun b = fun();
+  const Fun c = fun();
+
+  // (a = n1 ^ b = n1) v (a = n1 ^ c = n1)
+  const F phi = F::Or(F::And(F::Lit(Lit::Eq(a, n1)), F::Lit(Lit::Eq(b, n1))),
+                      F::And(F::Lit(Lit::Eq(a, n1)), F::Lit(Lit::Eq(c, n1))));
+  const F query = F::Lit(Lit::Eq(a, n1));
+
+  {
+    // Distributed, a = n1 is a unit clause and believed at level 0.
+    Grounder grounder;
+    LimSat lim_sat;
+    std::vector<std::vector<Lit>> cs;
+    const Grounder::node_t root = grounder.Ground(phi.readable(), [](const Abc::Sort) { return std::vector<Name>(); });
+    EXPECT_TRUE(grounder.DefinitionalClauses(root, [&](const std::vector<Lit>& c) { cs.push_back(c); lim_sat.AddClause(c); }));
+    EXPECT_EQ(Sorted(cs), Sorted({{Lit::Eq(a, n1)}, {Lit::Eq(a, n1), Lit::Eq(c, n1)},
+                                  {Lit::Eq(b, n1), Lit::Eq(a, n1)}, {Lit::Eq(b, n1), Lit::Eq(c, n1)}}));
+    EXPECT_FALSE(lim_sat.Solve(0, query.readable()));
+  }
+
+  {
+    // With definitions, a = n1 is only believed after a split.
+    Grounder grounder;
+    grounder.set_max_distributed(-1);
+    LimSat lim_sat;
+    std::vector<std::vector<Lit>> cs;
+    const Grounder::node_t root = grounder.Ground(phi.readable(), [](const Abc::Sort) { return std::vector<Name>(); });
+    EXPECT_TRUE(grounder.DefinitionalClauses(root, [&](const std::vector<Lit>& c) { cs.push_back(c); lim_sat.AddClause(c); }));
+    EXPECT_EQ(cs.size(), 1u + 2u + 2u);
+    EXPECT_TRUE(lim_sat.Solve(0, query.readable()));
+    EXPECT_FALSE(lim_sat.Solve(1, query.readable()));
+  }
+}
+
+}  // namespace limbo
@@ -43,6 +43,26 @@ TEST(IntsTest, BitConcatenator) {
   EXPECT_EQ(BitConcatenator<u32>::merge(0b000101, 0b000011), (0b000101L << 32) | 0b000011L);
 }
 
+template<typename Bits, typename T>
+static void TestSplitAndHiZero() {
+  for (const T hi : {T(0), T(1), T(0b1011), T(~T(0))}) {
+    for (const T lo : {T(0), T(1), T(0b0110), T(~T(0))}) {
+      const auto z = Bits::merge(hi, lo);
+      EXPECT_EQ(Bits::split_hi(z), hi);
+      EXPECT_EQ(Bits::split_lo(z), lo);
+      EXPECT_TRUE(Bits::hi_zero(z ^ Bits::merge(hi, T(lo ^ 1))));
+      EXPECT_FALSE(Bits::hi_zero(z ^ Bits::merge(T(hi ^ 1), lo)));
+    }
+  }
+}
+
+TEST(IntsTest, split_and_hi_zero) {
+  TestSplitAndHiZero<BitInterleaver<u16>, u16>();
+  TestSplitAndHiZero<BitInterleaver<u32>, u32>();
+  TestSplitAndHiZero<BitConcatenator<u16>, u16>();
+  TestSplitAndHiZero<BitConcatenator<u32>, u32>();
+}
+
 TEST(IntsTest, next_power_of_two) {
   EXPECT_EQ(next_power_of_two(128), 128);
   EXPECT_EQ(next_power_of_two(127), 128);
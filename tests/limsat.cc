@@ -10,6 +10,240 @@ namespace limbo {
 TEST(LimSatTest, LimSat) {
 }
 
+TEST(LimSatTest, Relevance) {
+  const Fun f1 = Fun::FromId(1);
+  const Fun f2 = Fun::FromId(2);
+  const Fun f3 = Fun::FromId(3);
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  auto make_lim_sat = [=](LimSat* lim_sat) {
+    lim_sat->AddClause({Lit::Eq(f1, n1)});
+    lim_sat->AddClause({Lit::Neq(f1, n1), Lit::Eq(f2, n1)});
+    lim_sat->AddClause({Lit::Eq(f3, n2)});
+  };
+  const Formula query = Formula::Lit(Lit::Eq(f2, n1));
+
+  {
+    LimSat lim_sat;
+    make_lim_sat(&lim_sat);
+    EXPECT_EQ(lim_sat.relevance_radius(), -1);
+    EXPECT_FALSE(lim_sat.Solve(0, query.readable()));
+    EXPECT_EQ(lim_sat.statistics().relevant_clauses, 3);
+    EXPECT_EQ(lim_sat.statistics().relevant_funs, 3);
+  }
+
+  {
+    // f1 = n1 is outside of the bound, but it is derived by unit propagation.
+    LimSat lim_sat;
+    make_lim_sat(&lim_sat);
+    lim_sat.set_relevance_radius(1);
+    EXPECT_FALSE(lim_sat.Solve(0, query.readable()));
+    EXPECT_EQ(lim_sat.statistics().relevant_clauses, 1);
+    EXPECT_EQ(lim_sat.statistics().relevant_funs, 2);
+    EXPECT_FALSE(lim_sat.Solve(0, query.readable()));
+    EXPECT_EQ(lim_sat.statistics().relevant_clauses, 1);
+    EXPECT_FALSE(lim_sat.Solve(1, query.readable()));
+    EXPECT_EQ(lim_sat.statistics().relevant_clauses, 2);
+    EXPECT_EQ(lim_sat.statistics().relevant_funs, 2);
+  }
+
+  {
+    LimSat lim_sat;
+    make_lim_sat(&lim_sat);
+    lim_sat.set_relevance_radius(2);
+    EXPECT_FALSE(lim_sat.Solve(0, query.readable()));
+    EXPECT_EQ(lim_sat.statistics().relevant_clauses, 2);
+    EXPECT_EQ(lim_sat.statistics().relevant_funs, 2);
+  }
+
+  for (int r = 1; r <= 2; ++r) {
+    for (int k = 0; k <= 1; ++k) {
+      // The second query adds n2 to the domain of f1, which must not reuse the
+      // filtered problem of the first one, whose extra name is n2.
+      LimSat lim_sat;
+      lim_sat.AddClause({Lit::Neq(f1, n1)});
+      lim_sat.AddClause({Lit::Eq(f2, n1)});
+      lim_sat.set_relevance_radius(r);
+      EXPECT_FALSE(lim_sat.Solve(k, Formula::Lit(Lit::Neq(f1, n1)).readable()));
+      EXPECT_TRUE(lim_sat.Solve(k, Formula::Lit(Lit::Eq(f1, n2)).readable()));
+      LimSat fresh;
+      fresh.AddClause({Lit::Neq(f1, n1)});
+      fresh.AddClause({Lit::Eq(f2, n1)});
+      EXPECT_TRUE(fresh.Solve(k, Formula::Lit(Lit::Eq(f1, n2)).readable()));
+    }
+  }
+}
+
+TEST(LimSatTest, RelevanceAgrees) {
+  // A chain f1 = n1 -> f2 = n1 -> ... -> f6 = n1 with a disjunction on f7
+  // attached to its end.
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  auto fun = [](int i) { return Fun::FromId(i); };
+  std::vector<std::vector<Lit>> clauses = {{Lit::Eq(fun(1), n1)}};
+  for (int i = 1; i < 6; ++i) {
+    clauses.push_back({Lit::Neq(fun(i), n1), Lit::Eq(fun(i + 1), n1)});
+  }
+  clauses.push_back({Lit::Neq(fun(6), n1), Lit::Eq(fun(7), n1), Lit::Eq(fun(7), n2)});
+  std::vector<Formula> queries;
+  for (int i = 1; i <= 7; ++i) {
+    queries.push_back(Formula::Lit(Lit::Eq(fun(i), n1)));
+    queries.push_back(Formula::Lit(Lit::Neq(fun(i), n1)));
+  }
+  queries.push_back(Formula::Or(Formula::Lit(Lit::Eq(fun(7), n1)), Formula::Lit(Lit::Eq(fun(7), n2))));
+
+  LimSat full;
+  for (const std::vector<Lit>& c : clauses) {
+    full.AddClause(c);
+  }
+  for (int r = 0; r <= 8; ++r) {
+    LimSat lim_sat;
+    for (const std::vector<Lit>& c : clauses) {
+      lim_sat.AddClause(c);
+    }
+    lim_sat.set_relevance_radius(r);
+    for (const Formula& q : queries) {
+      // At level 0, the base units make the filter exact.
+      EXPECT_EQ(lim_sat.Solve(0, q.readable()), full.Solve(0, q.readable()));
+      // Once the radius covers the clauses, the filter is exact at every level.
+      for (int k = 1; k <= 2 && r >= 8; ++k) {
+        EXPECT_EQ(lim_sat.Solve(k, q.readable()), full.Solve(k, q.readable()));
+      }
+    }
+    // The cached relevant clauses are invalidated by new clauses.
+    const Formula q = Formula::Lit(Lit::Eq(fun(8), n1));
+    EXPECT_TRUE(lim_sat.Solve(0, q.readable()));
+    lim_sat.AddClause({Lit::Neq(fun(1), n1), Lit::Eq(fun(8), n1)});
+    EXPECT_FALSE(lim_sat.Solve(0, q.readable()));
+  }
+}
+
+TEST(LimSatTest, Budget) {
+  const Fun f1 = Fun::FromId(1);
+  const Fun f2 = Fun::FromId(2);
+  const Name n1 = Name::FromId(1);
+  LimSat lim_sat;
+  lim_sat.AddClause({Lit::Eq(f1, n1)});
+  lim_sat.AddClause({Lit::Neq(f1, n1), Lit::Eq(f2, n1)});
+  const Formula believed = Formula::Lit(Lit::Eq(f2, n1));
+  const Formula not_believed = Formula::Lit(Lit::Neq(f2, n1));
+
+  EXPECT_EQ(lim_sat.Solve(0, believed.readable(), LimSat::Budget()), LimSat::Truth::kUnsat);
+  EXPECT_EQ(lim_sat.Solve(0, not_believed.readable(), LimSat::Budget()), LimSat::Truth::kSat);
+  EXPECT_GE(lim_sat.statistics().models, 1);
+
+  LimSat::Budget no_models;
+  no_models.models = 0;
+  EXPECT_EQ(lim_sat.Solve(0, believed.readable(), no_models), LimSat::Truth::kUnknown);
+  EXPECT_EQ(lim_sat.Solve(0, not_believed.readable(), no_models), LimSat::Truth::kUnknown);
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+
+  LimSat::Budget no_time;
+  no_time.seconds = 0.0;
+  EXPECT_EQ(lim_sat.Solve(0, believed.readable(), no_time), LimSat::Truth::kUnknown);
+
+  EXPECT_EQ(lim_sat.Solve(1, believed.readable(), LimSat::Budget()), LimSat::Truth::kUnsat);
+  EXPECT_FALSE(lim_sat.Solve(0, believed.readable()));
+}
+
+TEST(LimSatTest, Ladder) {
+  const Fun f1 = Fun::FromId(1);
+  const Fun f2 = Fun::FromId(2);
+  const Fun f3 = Fun::FromId(3);
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  LimSat lim_sat;
+  lim_sat.AddClause({Lit::Eq(f1, n1)});
+  lim_sat.AddClause({Lit::Neq(f1, n1), Lit::Eq(f2, n1)});
+  lim_sat.AddClause({Lit::Eq(f3, n1), Lit::Eq(f3, n2)});
+  const Formula believed = Formula::Lit(Lit::Eq(f2, n1));
+  const Formula not_believed = Formula::Lit(Lit::Eq(f3, n1));
+
+  LimSat::Ladder ladder1;
+  EXPECT_FALSE(lim_sat.Solve(0, believed.readable(), &ladder1));
+  EXPECT_FALSE(lim_sat.Solve(1, believed.readable(), &ladder1));
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+  EXPECT_FALSE(lim_sat.Solve(2, believed.readable(), &ladder1));
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+
+  LimSat::Ladder ladder2;
+  for (int k = 0; k <= 2; ++k) {
+    EXPECT_EQ(lim_sat.Solve(k, not_believed.readable(), &ladder2), lim_sat.Solve(k, not_believed.readable()));
+  }
+  EXPECT_TRUE(lim_sat.Solve(1, not_believed.readable(), &ladder2));
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+
+  lim_sat.AddClause({Lit::Eq(f3, n1)});
+  EXPECT_FALSE(lim_sat.Solve(0, not_believed.readable(), &ladder2));
+  EXPECT_FALSE(lim_sat.Solve(1, not_believed.readable(), &ladder2));
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+}
+
+TEST(LimSatTest, LadderReusesModels) {
+  // A chain f1 = n1 -> ... -> f6 = n1 where f1, ..., f5 are n1 or n2, so the
+  // query f6 = n1 is not believed at any level.
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  auto fun = [](int i) { return Fun::FromId(i); };
+  LimSat lim_sat;
+  for (int i = 1; i < 6; ++i) {
+    lim_sat.AddClause({Lit::Neq(fun(i), n1), Lit::Eq(fun(i + 1), n1)});
+    lim_sat.AddClause({Lit::Eq(fun(i), n1), Lit::Eq(fun(i), n2)});
+  }
+  const Formula query = Formula::Lit(Lit::Eq(fun(6), n1));
+
+  int models_without_ladder = 0;
+  int models_with_ladder = 0;
+  LimSat::Ladder ladder;
+  for (int k = 0; k <= 3; ++k) {
+    EXPECT_TRUE(lim_sat.Solve(k, query.readable()));
+    models_without_ladder += lim_sat.statistics().models;
+    EXPECT_TRUE(lim_sat.Solve(k, query.readable(), &ladder));
+    models_with_ladder += lim_sat.statistics().models;
+    if (k >= 2) {
+      // The models from level k - 1 seed the search and suffice at level k.
+      EXPECT_EQ(lim_sat.statistics().models, 0);
+    }
+  }
+  EXPECT_LT(models_with_ladder, models_without_ladder);
+}
+
+TEST(LimSatTest, LitAndClauseQueries) {
+  const Fun f1 = Fun::FromId(1);
+  const Fun f2 = Fun::FromId(2);
+  const Fun f3 = Fun::FromId(3);
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  LimSat lim_sat;
+  lim_sat.AddClause({Lit::Eq(f1, n1)});
+  lim_sat.AddClause({Lit::Neq(f1, n1), Lit::Eq(f2, n1)});
+  lim_sat.AddClause({Lit::Eq(f3, n1), Lit::Eq(f3, n2)});
+  const std::vector<Lit> lits = {Lit::Eq(f1, n1), Lit::Eq(f2, n1), Lit::Neq(f2, n1), Lit::Eq(f3, n1), Lit::Neq(f3, n2)};
+  std::vector<std::vector<Lit>> clauses = {{}, {Lit::Eq(f3, n1), Lit::Eq(f3, n2)}, {Lit::Neq(f2, n1), Lit::Eq(f3, n1)}};
+  for (const Lit a : lits) {
+    clauses.push_back({a});
+  }
+  for (int k = 0; k <= 2; ++k) {
+    for (const Lit a : lits) {
+      EXPECT_EQ(lim_sat.Solve(k, a), lim_sat.Solve(k, Formula::Lit(a).readable()));
+    }
+    for (const std::vector<Lit>& c : clauses) {
+      std::vector<Formula> fs;
+      for (const Lit a : c) {
+        fs.push_back(Formula::Lit(a));
+      }
+      EXPECT_EQ(lim_sat.Solve(k, c), lim_sat.Solve(k, Formula::Or(fs).readable()));
+    }
+  }
+  EXPECT_FALSE(lim_sat.Solve(0, Lit::Eq(f2, n1)));
+  EXPECT_TRUE(lim_sat.Solve(0, Lit::Eq(f3, n1)));
+  EXPECT_FALSE(lim_sat.Solve(1, std::vector<Lit>{Lit::Eq(f3, n1), Lit::Eq(f3, n2)}));
+
+  LimSat::Ladder ladder;
+  EXPECT_EQ(lim_sat.Solve(0, Lit::Eq(f2, n1), LimSat::Budget(), &ladder), LimSat::Truth::kUnsat);
+  EXPECT_FALSE(lim_sat.Solve(1, Lit::Eq(f2, n1), &ladder));
+  EXPECT_EQ(lim_sat.statistics().models, 0);
+}
 
 }  // namespace limbo
  
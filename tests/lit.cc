@@ -1,6 +1,9 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2014 Christoph Schwering
 
+#include <algorithm>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <limbo/lit.h>
@@ -47,6 +50,24 @@ TEST(LitTest, NameComparison) {
   EXPECT_GE(Name::FromId(2), Name::FromId(1));
 }
 
+TEST(LitTest, MaxIds) {
+  EXPECT_EQ(sizeof(Lit), sizeof(Fun) + sizeof(Name));
+  const internal::u64 max_fun = Fun::kMaxId;
+  const internal::u64 max_name = Name::kMaxId;
+  const Fun f = Fun::FromIdChecked(max_fun);
+  const Name n = Name::FromIdChecked(max_name);
+  EXPECT_EQ(f.id(), max_fun);
+  EXPECT_EQ(n.id(), max_name);
+  for (const bool pos : {true, false}) {
+    const Lit a(pos, f, n);
+    EXPECT_EQ(a.pos(), pos);
+    EXPECT_EQ(a.fun(), f);
+    EXPECT_EQ(a.name(), n);
+  }
+  EXPECT_DEATH(Fun::FromIdChecked(max_fun + 1), "exceeds");
+  EXPECT_DEATH(Name::FromIdChecked(max_name + 1), "exceeds");
+}
+
 TEST(LitTest, LitComparison) {
   Fun f1 = Fun::FromId(1);
   Fun f2 = Fun::FromId(2);
@@ -137,5 +158,24 @@ TEST(LitTest, LitSubsumes) {
   EXPECT_FALSE(Lit::ProperlySubsumes(Lit::Eq (f, n), Lit::Neq(g, n)));
 }
 
+TEST(LitTest, LitSubsumesAny) {
+  std::vector<Lit> lits;
+  for (int f = 1; f <= 3; ++f) {
+    for (int n = 1; n <= 3; ++n) {
+      lits.push_back(Lit::Eq(Fun::FromId(f), Name::FromId(n)));
+      lits.push_back(Lit::Neq(Fun::FromId(f), Name::FromId(n)));
+    }
+  }
+  // All windows, so that both the block loop and the remainder are tested.
+  for (const Lit a : lits) {
+    for (size_t i = 0; i <= lits.size(); ++i) {
+      for (size_t j = i; j <= lits.size(); ++j) {
+        const bool expected = std::any_of(lits.data() + i, lits.data() + j, [a](Lit b) { return a.Subsumes(b); });
+        EXPECT_EQ(Lit::SubsumesAny(a, lits.data() + i, lits.data() + j), expected);
+      }
+    }
+  }
+}
+
 }  // namespace limbo
 
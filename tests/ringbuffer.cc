@@ -2,6 +2,7 @@
 // Copyright 2016 Christoph Schwering
 
 #include <cstdint>
+#include <type_traits>
 
 #include <gtest/gtest.h>
 
@@ -52,6 +53,47 @@ TEST(RingBufferTest, RingBufferFrontAndBack) {
   }
 }
 
+TEST(RingBufferTest, RingBufferInlineAndMove) {
+  RingBuffer<int, 4> rb;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      rb.PushBack(i);
+    }
+    EXPECT_EQ(rb.PopFront(), 0);
+    rb.PushFront(0);
+    EXPECT_EQ(rb.size(), 3);
+    for (int i = 0; i < rb.size(); ++i) {
+      EXPECT_EQ(rb[i], i);
+    }
+    RingBuffer<int, 4> tmp(std::move(rb));
+    EXPECT_TRUE(rb.empty());
+    EXPECT_EQ(tmp.size(), 3);
+    EXPECT_EQ(tmp.PopBack(), 2);
+    EXPECT_EQ(tmp.PopBack(), 1);
+    EXPECT_EQ(tmp.PopBack(), 0);
+    rb = std::move(tmp);
+    EXPECT_TRUE(rb.empty());
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    rb.PushBack(i);
+    if (i % 2 == 0) {
+      EXPECT_EQ(rb.PopFront(), i / 2);
+    }
+  }
+  EXPECT_EQ(rb.size(), 50);
+  for (int i = 0; i < rb.size(); ++i) {
+    EXPECT_EQ(rb[i], i + 50);
+  }
+  RingBuffer<int, 4> small;
+  small.PushBack(7);
+  rb = std::move(small);
+  EXPECT_EQ(rb.size(), 1);
+  EXPECT_EQ(rb[0], 7);
+  EXPECT_TRUE(small.empty());
+  EXPECT_TRUE(std::is_nothrow_move_constructible<RingBuffer<int>>::value);
+}
+
 }  // namespace internal
 }  // namespace limbo
 
@@ -1,6 +1,9 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2014 Christoph Schwering
 
+#include <type_traits>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <limbo/sat.h>
@@ -10,6 +13,94 @@ namespace limbo {
 TEST(SatTest, sat) {
 }
 
+TEST(SatTest, Track) {
+  const Fun f1 = Fun::FromId(1);
+  const Fun f2 = Fun::FromId(2);
+  const Fun f3 = Fun::FromId(3);
+  const Name n1 = Name::FromId(1);
+  const Name n2 = Name::FromId(2);
+  Sat<> sat;
+  for (const Fun f : {f1, f2, f3}) {
+    for (const Name n : {n1, n2}) {
+      sat.Register(f, n);
+    }
+  }
+  sat.AddClause({Lit::Eq(f1, n1)});
+  sat.AddClause({Lit::Neq(f1, n1), Lit::Eq(f2, n1)});
+  sat.Track(f1);
+  sat.Track(f2);
+  EXPECT_TRUE(sat.tracked(f1));
+  EXPECT_FALSE(sat.tracked(f3));
+  EXPECT_EQ(sat.tracked_size(), 2);
+  EXPECT_EQ(sat.tracked_model_size(), 1);
+  EXPECT_FALSE(sat.tracked_all_assigned());
+
+  auto go = [](auto&&...) { return true; };
+  EXPECT_EQ(sat.Solve(go, go), Sat<>::Truth::kSat);
+  EXPECT_EQ(sat.tracked_model_size(), 2);
+  EXPECT_TRUE(sat.tracked_all_assigned());
+
+  sat.Track(f3);
+  EXPECT_EQ(sat.tracked_size(), 3);
+  EXPECT_EQ(sat.tracked_model_size(), 3);
+  sat.Track(f1, false);
+  EXPECT_EQ(sat.tracked_size(), 2);
+  EXPECT_EQ(sat.tracked_model_size(), 2);
+
+  sat.Reset();
+  int n = 0;
+  for (const Fun f : {f1, f2, f3}) {
+    n += sat.tracked(f) && !sat.model()[f].null();
+  }
+  EXPECT_EQ(sat.tracked_model_size(), n);
+
+  sat.Untrack();
+  EXPECT_EQ(sat.tracked_size(), 0);
+  EXPECT_EQ(sat.tracked_model_size(), 0);
+}
+
+TEST(SatTest, FunQueues) {
+  auto test = [](auto&& sat) {
+    using SatT = typename std::remove_reference<decltype(sat)>::type;
+    const std::vector<Fun> funs = {Fun::FromId(1), Fun::FromId(2), Fun::FromId(3), Fun::FromId(4)};
+    const std::vector<Name> names = {Name::FromId(1), Name::FromId(2), Name::FromId(3)};
+    for (const Fun f : funs) {
+      for (const Name n : names) {
+        sat.Register(f, n);
+      }
+    }
+    for (const Fun f1 : {funs[0], funs[1], funs[2]}) {
+      for (const Fun f2 : {funs[0], funs[1], funs[2]}) {
+        for (const Name n : names) {
+          if (f1.id() < f2.id()) {
+            sat.AddClause({Lit::Neq(f1, n), Lit::Neq(f2, n)});
+          }
+        }
+      }
+    }
+    auto go = [](auto&&...) { return true; };
+    EXPECT_EQ(sat.Solve(go, go), SatT::Truth::kSat);
+    for (const Fun f : funs) {
+      EXPECT_FALSE(sat.model()[f].null());
+    }
+    EXPECT_NE(sat.model()[funs[0]], sat.model()[funs[1]]);
+    EXPECT_NE(sat.model()[funs[0]], sat.model()[funs[2]]);
+    EXPECT_NE(sat.model()[funs[1]], sat.model()[funs[2]]);
+
+    sat.Reset(typename SatT::KeepLearnt{true}, [&funs](const Fun f) { return f == funs[3] ? 1.0 : 0.0; });
+    EXPECT_EQ(sat.Solve(go, go), SatT::Truth::kSat);
+    sat.Reset();
+    sat.AddClause({Lit::Neq(funs[2], names[2])});
+    sat.AddClause({Lit::Neq(funs[1], names[2])});
+    EXPECT_EQ(sat.Solve(go, go), SatT::Truth::kSat);
+    EXPECT_EQ(sat.model()[funs[0]], names[2]);
+    sat.Reset();
+    sat.AddClause({Lit::Neq(funs[0], names[2])});
+    EXPECT_EQ(sat.Solve(go, go), SatT::Truth::kUnsat);
+  };
+  test(Sat<>());
+  test(Sat<double, MoveToFrontQueue>());
+}
 
 }  // namespace limbo
  
@@ -1,6 +1,8 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2019 Christoph Schwering
 
+#include <algorithm>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -113,6 +115,88 @@ TEST(SubsetsTest, subsets_one_ternary_set_cardinality_three) {
   EXPECT_TRUE(r);
 }
 
+TEST(SubsetsTest, combinations_rank_unrank) {
+  EXPECT_EQ(Binomial(5, 2), 10u);
+  EXPECT_EQ(Binomial(5, 0), 1u);
+  EXPECT_EQ(Binomial(2, 5), 0u);
+  Combinations c(6, 3);
+  EXPECT_EQ(c.count(), 20u);
+  std::set<std::vector<int>> Ys;
+  u64 r = 0;
+  for (; c.valid(); c.Next(), ++r) {
+    EXPECT_EQ(c.rank(), r);
+    Combinations d(6, 3);
+    d.Unrank(r);
+    EXPECT_TRUE(d.valid());
+    EXPECT_TRUE(std::equal(c.begin(), c.end(), d.begin()));
+    Ys.insert(std::vector<int>(c.begin(), c.end()));
+  }
+  EXPECT_EQ(r, 20u);
+  EXPECT_EQ(Ys.size(), 20u);
+  c.Unrank(20);
+  EXPECT_FALSE(c.valid());
+}
+
+TEST(SubsetsTest, combined_combinations_rank_unrank_prune) {
+  CombinedCombinations cc({3, 2, 4}, 3);
+  std::set<std::vector<int>> Ys;
+  u64 r = 0;
+  for (; cc.valid(); cc.Next(), ++r) {
+    EXPECT_EQ(cc.rank(), r);
+    CombinedCombinations dd({3, 2, 4}, 3);
+    dd.Unrank(r);
+    EXPECT_TRUE(dd.valid());
+    std::vector<int> ys;
+    for (int b = 0; b < cc.buckets(); ++b) {
+      EXPECT_LT(cc[b].k(), 3);
+      EXPECT_TRUE(std::equal(cc[b].begin(), cc[b].end(), dd[b].begin()));
+      for (const int i : cc[b]) {
+        ys.push_back(10 * b + i);
+      }
+    }
+    EXPECT_EQ(ys.size(), 3u);
+    Ys.insert(ys);
+  }
+  EXPECT_EQ(r, cc.count());
+  EXPECT_EQ(Ys.size(), cc.count());
+  // All 3-subsets of 9 elements except those within a single bucket and those
+  // that contain the whole second bucket.
+  EXPECT_EQ(cc.count(), Binomial(9, 3) - Binomial(3, 3) - Binomial(4, 3) - (3 + 4));
+
+  int n = 0;
+  for (CombinedCombinations cc({3, 3}, 2); cc.valid(); cc.Prune(0)) {
+    EXPECT_EQ(cc[0].k(), 1);
+    ++n;
+  }
+  EXPECT_EQ(n, 3);
+
+  // With several groups, Prune(0) skips within a group only: the counts are
+  // (0,1,2), (0,2,1), (1,0,2), (1,1,1), (1,2,0), (2,0,1), (2,1,0), and every
+  // group is visited once per combination of the first bucket.
+  n = 0;
+  std::vector<std::vector<int>> counts;
+  std::set<std::vector<int>> firsts_in_group;
+  std::map<std::vector<int>, int> groups_per_first;
+  for (CombinedCombinations cc({3, 3, 3}, 3); cc.valid(); cc.Prune(0)) {
+    std::vector<int> cs;
+    for (int b = 0; b < cc.buckets(); ++b) {
+      cs.push_back(cc[b].k());
+    }
+    if (counts.empty() || counts.back() != cs) {
+      counts.push_back(cs);
+      firsts_in_group.clear();
+    }
+    const std::vector<int> first(cc[0].begin(), cc[0].end());
+    EXPECT_TRUE(firsts_in_group.insert(first).second);
+    ++groups_per_first[first];
+    ++n;
+  }
+  EXPECT_EQ(counts, (std::vector<std::vector<int>>{{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 1, 1}, {1, 2, 0},
+                                                    {2, 0, 1}, {2, 1, 0}}));
+  EXPECT_EQ(n, 1 + 1 + 3 + 3 + 3 + 3 + 3);
+  EXPECT_EQ(groups_per_first[std::vector<int>{0}], 3);
+}
+
 }  // namespace internal
 }  // namespace limbo
 